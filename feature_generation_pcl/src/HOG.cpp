@@ -5,6 +5,12 @@ Copyright (C) 2012 Hema Koppula
 
 #include <math.h>
 #include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <string>
 // small value, used to avoid division by zero
 #define eps 0.0001
 
@@ -20,6 +26,50 @@ class Point2D
   Point2D() {}
 };
 
+// a rectangle of HOG blocks as indexed by HOG::getFeatVec, bounds included
+class BlockRect
+{
+ public:
+  int minX;
+  int minY;
+  int maxX;
+  int maxY;
+  BlockRect(int minX_, int minY_, int maxX_, int maxY_) {
+    minX=minX_;
+    minY=minY_;
+    maxX=maxX_;
+    maxY=maxY_;
+  }
+};
+
+/*
+An 8 bit image in any layout: channel c of pixel (x, y) is at
+data[c*channelStride + y*rowStride + x*pixelStride]. This views planar
+buffers as well as interleaved ones, e.g. the colors of a point cloud.
+ */
+class ByteImageView
+{
+ public:
+  const unsigned char *data;
+  int width;
+  int height;
+  int channels;
+  int pixelStride;
+  int rowStride;
+  int channelStride;
+  ByteImageView(const unsigned char *data_, int width_, int height_,
+                int channels_, int pixelStride_, int rowStride_,
+                int channelStride_) {
+    data=data_;
+    width=width_;
+    height=height_;
+    channels=channels_;
+    pixelStride=pixelStride_;
+    rowStride=rowStride_;
+    channelStride=channelStride_;
+  }
+};
+
 
 class HOGFeaturesOfBlock {
  public:
@@ -67,26 +117,188 @@ class HOGFeaturesOfBlock {
   }
 };
 
+/*
+The part of an image needed for the HOG features of some of its blocks: the
+blocks, the cells within one cell of them, whose histograms normalize the
+blocks, and the pixels which add to those cells. getFeatVec does not check
+its block, so a block is marked by its offset in the features: a block past
+the end of a column is the first block of the next one, which is what
+getFeatVec returns for it.
+ */
+class HOGRegion {
+ public:
+  HOGRegion(const std::vector<BlockRect> &rects, const int *blocks,
+            const int *out, int sbin, int visibleY)
+      : sbin_(sbin),
+        visibleY_(visibleY),
+        blockNeeded_(out[0]*out[1], 0),
+        cellNeeded_(blocks[0]*blocks[1], 0),
+        rows_((blocks[1]+1)*visibleY, 0),
+        anyRow_(blocks[1]+1, 0) {
+    blocks_[0] = blocks[0];
+    blocks_[1] = blocks[1];
+    int numBlocks = out[0]*out[1];
+    for (size_t r = 0; r < rects.size(); r++) {
+      for (int bx = rects[r].minX; bx <= rects[r].maxX; bx++) {
+        for (int by = rects[r].minY; by <= rects[r].maxY; by++) {
+          int offset = bx*out[0] + by;
+          if (offset < 0 || offset >= numBlocks || blockNeeded_[offset])
+            continue;
+          blockNeeded_[offset] = 1;
+          // block (x, y) is normalized by the cells x..x+2, y..y+2
+          int x = offset / out[0];
+          int y = offset % out[0];
+          for (int cx = x; cx <= x+2; cx++)
+            for (int cy = y; cy <= y+2; cy++)
+              cellNeeded_[cx*blocks[0] + cy] = 1;
+        }
+      }
+    }
+    // the pixels of a column add to the cell columns cx and cx+1, where cx
+    // goes from -1 to blocks[1]-1
+    for (int cx = -1; cx < blocks[1]; cx++) {
+      char *rows = &rows_[(cx+1)*visibleY];
+      for (int y = 0; y < visibleY; y++) {
+        int cy = cellOfPixel(y);
+        rows[y] = isCellNeeded(cx, cy) || isCellNeeded(cx+1, cy) ||
+                  isCellNeeded(cx, cy+1) || isCellNeeded(cx+1, cy+1);
+        anyRow_[cx+1] = anyRow_[cx+1] || rows[y];
+      }
+    }
+  }
+
+  bool isBlockNeeded(int offset) const {
+    return blockNeeded_[offset];
+  }
+
+  // whether each pixel of column x adds to a needed cell, NULL if none does
+  const char *getRows(int x) const {
+    int cx = cellOfPixel(x);
+    return anyRow_[cx+1] ? &rows_[(cx+1)*visibleY_] : NULL;
+  }
+
+ private:
+  int sbin_;
+  int visibleY_;
+  int blocks_[2];
+  std::vector<char> blockNeeded_;
+  std::vector<char> cellNeeded_;
+  std::vector<char> rows_;  // of each cell column, see getRows
+  std::vector<char> anyRow_;
+
+  // a pixel adds to the cells c and c+1 (in x or y)
+  int cellOfPixel(int p) const {
+    return (int)floor(((double)p+0.5)/(double)sbin_ - 0.5);
+  }
+
+  bool isCellNeeded(int cx, int cy) const {
+    return cx >= 0 && cx < blocks_[1] && cy >= 0 && cy < blocks_[0] &&
+           cellNeeded_[cx*blocks_[0] + cy];
+  }
+};
+
 class HOG {
   static double const uu[9];
   static double const vv[9];
   // unit vectors used to compute gradient orientation
-  double *feat;
+
+  // buffers of the kernel of type T, reused from one image to the next
+  template <typename T>
+  struct Workspace {
+    std::vector<T> image;  // column-major color planes
+    std::vector<T> hist;  // orientation histograms of the cells
+    std::vector<T> norm;  // energy of the cells
+
+    void swap(Workspace &other) {
+      image.swap(other.image);
+      hist.swap(other.hist);
+      norm.swap(other.norm);
+    }
+  };
+
+  Workspace<double> doubleWorkspace;
+  Workspace<float> floatWorkspace;
+  std::vector<double> feat;
   int numBlocksOutX;
   int numBlocksOutY;
+  // sums of each feature over the blocks (0..x-1, 0..y-1), laid out as feat
+  // with numBlocksOutX+1 by numBlocksOutY+1 entries per feature
+  std::vector<double> integral;
 
 public :
+  // use the single precision SSE kernel, see process(const float *, ...)
+  static bool useFloatKernel;
+
   HOG() {
-    feat=NULL;
+    numBlocksOutX=0;
+    numBlocksOutY=0;
+  }
+
+  // parses --hog-kernel=double|float, returns false for any other option
+  static bool parseKernelOption(const std::string &option) {
+    if (option.compare("--hog-kernel=double") == 0) {
+      useFloatKernel = false;
+    } else if (option.compare("--hog-kernel=float") == 0) {
+      useFloatKernel = true;
+    } else {
+      return false;
+    }
+    return true;
   }
 
   ~HOG() {}
 
+  void swap(HOG &other) {
+    doubleWorkspace.swap(other.doubleWorkspace);
+    floatWorkspace.swap(other.floatWorkspace);
+    feat.swap(other.feat);
+    std::swap(numBlocksOutX, other.numBlocksOutX);
+    std::swap(numBlocksOutY, other.numBlocksOutY);
+    integral.swap(other.integral);
+  }
+
   void getFeatVec(int blockY, int blockX, HOGFeaturesOfBlock & featsB)
   {
     for(int featIndex = 0; featIndex<HOGFeaturesOfBlock::numFeats; featIndex++)
-        featsB.feats[featIndex] = *(feat + featIndex*numBlocksOutX*numBlocksOutY
-                                    + blockX*numBlocksOutY + blockY);
+        featsB.feats[featIndex] = feat[featIndex*numBlocksOutX*numBlocksOutY
+                                       + blockX*numBlocksOutY + blockY];
+  }
+
+  /*
+  Mean features of the blocks minBlockY..maxBlockY by minBlockX..maxBlockX
+  (bounds included), from four entries of the integral of each feature, so
+  the cost does not depend on the size of the box. It differs from
+  averaging the blocks by rounding only, below 1e-12. Boxes which are empty
+  or not inside the blocks are averaged block by block, reading the blocks
+  getFeatVec reads, as before.
+   */
+  void getMeanFeatVec(int minBlockY, int maxBlockY, int minBlockX,
+                      int maxBlockX, HOGFeaturesOfBlock & mean)
+  {
+    if (minBlockX < 0 || maxBlockX >= numBlocksOutX || minBlockX > maxBlockX ||
+        minBlockY < 0 || maxBlockY >= numBlocksOutY || minBlockY > maxBlockY) {
+      std::vector<HOGFeaturesOfBlock> blocks;
+      for (int y = minBlockY; y <= maxBlockY; y++) {
+        for (int x = minBlockX; x <= maxBlockX; x++) {
+          blocks.push_back(HOGFeaturesOfBlock());
+          getFeatVec(y, x, blocks.back());
+        }
+      }
+      HOGFeaturesOfBlock::aggregateFeatsOfBlocks(blocks, mean);
+      return;
+    }
+    int sizeY = numBlocksOutY+1;
+    int plane = (numBlocksOutX+1)*sizeY;
+    int x0 = minBlockX*sizeY;
+    int x1 = (maxBlockX+1)*sizeY;
+    int y0 = minBlockY;
+    int y1 = maxBlockY+1;
+    double numBlocks = (double)(maxBlockX-minBlockX+1)*(maxBlockY-minBlockY+1);
+    const double *sums = &integral[0];
+    for (int f = 0; f < HOGFeaturesOfBlock::numFeats; f++, sums += plane) {
+      mean.feats[f] = (sums[x1+y1] - sums[x0+y1] - sums[x1+y0] + sums[x0+y0])
+                      / numBlocks;
+    }
   }
 
   static void saveFloatImage ( const char* filename, const IplImage * image) {
@@ -190,39 +402,104 @@ public :
 
   static  int const sbin=8;
 
-  void computeHog(IplImage * img) {
-    assert(img->nChannels == 3);
-    double * matlabImage =
-        (double *)calloc(img->width*img->height*img->nChannels,sizeof(double));
-    int ndims[3] = {img->height, img->width, 3};
-    for(size_t y = 0; y < img->height; y++)
-       for(size_t x = 0; x<img->width; x++) {
-         CvScalar s;
-         s = cvGet2D(img, y, x); // get the (i,j) pixel value
-         for(size_t ch=0;ch<img->nChannels;ch++) {
-           *(matlabImage + getOffsetInMatlabImage(y, x, ch, img->height,
-                                                  img->width)) = s.val[ch];
-         }
-      }
-    process(matlabImage, ndims);
-    free(matlabImage);
+  /*
+  HOG of the first three channels of an 8 bit image, whose values are
+  divided by maxValue first (e.g. 255 for colors in [0, 1]). Computes only
+  the features of the blocks in rects, and what they depend on: the
+  histograms of the cells within one cell of them, which are shared by
+  overlapping rectangles. The features of the other blocks are 0.
+   */
+  void computeHog(const ByteImageView &image, double maxValue,
+                  const std::vector<BlockRect> &rects) {
+    computeHog(image, maxValue, &rects);
   }
+
   // Assume IMAGE is width x height x 4
   void computeHOG(int ***IMAGE, int width, int height)
+  {
+    computeHOG(IMAGE, width, height, NULL);
+  }
+
+  // as computeHog(image, 1, rects)
+  void computeHOG(int ***IMAGE, int width, int height,
+                  const std::vector<BlockRect> &rects)
+  {
+    computeHOG(IMAGE, width, height, &rects);
+  }
+
+  // all the blocks if rects is NULL
+  void computeHog(const ByteImageView &image, double maxValue,
+                  const std::vector<BlockRect> *rects) {
+    if (useFloatKernel)
+      computeHogAs<float>(image, maxValue, rects);
+    else
+      computeHogAs<double>(image, maxValue, rects);
+  }
+
+  void computeHOG(int ***IMAGE, int width, int height,
+                  const std::vector<BlockRect> *rects)
+  {
+    if (useFloatKernel)
+      computeHOGAs<float>(IMAGE, width, height, rects);
+    else
+      computeHOGAs<double>(IMAGE, width, height, rects);
+  }
+
+  Workspace<double> &getWorkspace(double) { return doubleWorkspace; }
+  Workspace<float> &getWorkspace(float) { return floatWorkspace; }
+
+  template <typename T>
+  void computeHogAs(const ByteImageView &image, double maxValue,
+                    const std::vector<BlockRect> *rects) {
+    assert(image.channels >= 3);
+    // each value is converted as a float, as the colors of a point cloud
+    T values[256];
+    for (int v = 0; v < 256; v++)
+      values[v] = (float)(v / maxValue);
+    int ndims[3] = {image.height, image.width, 3};
+    std::vector<T> &planes = getWorkspace(T()).image;
+    planes.resize(image.width*image.height*3);
+    // read the image in memory order, a row at a time
+    for (int y = 0; y < image.height; y++) {
+      for (int ch = 0; ch < 3; ch++) {
+        const unsigned char *src =
+            image.data + ch*image.channelStride + y*image.rowStride;
+        T *dst = &planes[getOffsetInMatlabImage(y, 0, ch, image.height,
+                                                image.width)];
+        for (int x = 0; x < image.width; x++) {
+          *dst = values[*src];
+          src += image.pixelStride;
+          dst += image.height;
+        }
+      }
+    }
+    process(&planes[0], ndims, rects);
+  }
+
+  template <typename T>
+  void computeHOGAs(int ***IMAGE, int width, int height,
+                    const std::vector<BlockRect> *rects)
   {
     const int NCHANNELS = 4;
     int ndims[3] = {height, width, 3};
-    double * matlabImage=
-        (double *)calloc(width*height*(NCHANNELS-1),sizeof(double));
+    std::vector<T> &planes = getWorkspace(T()).image;
+    planes.resize(width*height*(NCHANNELS-1));
+    T * matlabImage = &planes[0];
 
     for(size_t y = 0; y < height; y++)
       for(size_t x = 0; x < width; x++) {
       	for(size_t ch = 0; ch < (NCHANNELS-1); ch++)
           *(matlabImage + getOffsetInMatlabImage(y, x, ch, height, width))
-              = (double) IMAGE[x][y][ch];
+              = (T) IMAGE[x][y][ch];
       }
-    process(matlabImage, ndims);
-    free(matlabImage);
+    process(matlabImage, ndims, rects);
+  }
+
+  // size entries of buffer, all 0
+  template <typename T>
+  static T *zeroed(std::vector<T> &buffer, size_t size) {
+    buffer.assign(size, 0);
+    return buffer.empty() ? NULL : &buffer[0];
   }
 
   size_t getOffsetInMatlabImage(size_t y, size_t x, size_t channel,
@@ -233,133 +510,391 @@ public :
 
   // main function:
   // takes a double color image and a bin size
-  // returns HOG features
-  void process(const double *im, const int *dims) {
-    // memory for caching orientation histograms & their norms
-    int numBlocksInX;
-    int numBlocksInY;
+  // returns HOG features, only those of the blocks in rects if not NULL
+  void process(const double *im, const int *dims,
+               const std::vector<BlockRect> *rects = NULL) {
     int blocks[2];
-    blocks[0] = (int)round((double)dims[0]/(double)sbin);
-    numBlocksInY=blocks[0];
-    blocks[1] = (int)round((double)dims[1]/(double)sbin);
-    numBlocksInX=blocks[1];
+    int out[3];
+    allocateFeatures(dims, blocks, out);
     // stores histogram of gradients along each direction in a block
-    double *hist = (double *)calloc(blocks[0]*blocks[1]*18, sizeof(double));
+    double *hist = zeroed(doubleWorkspace.hist, blocks[0]*blocks[1]*18);
     // stores for the norm for each block
-    double *norm = (double *)calloc(blocks[0]*blocks[1], sizeof(double));
-
-    // memory for HOG features
-    int out[3];
-    out[0] = max(blocks[0]-2, 0);  // ignore the boundary blocks ?
-    numBlocksOutY=out[0];
-
-    out[1] = max(blocks[1]-2, 0);
-    numBlocksOutX=out[1];
-    // 32 dimensional feature for each block
-    out[2] = HOGFeaturesOfBlock::numFeats ;
-    feat = (double *)calloc(out[0]*out[1]*out[2],sizeof(double));
+    double *norm = zeroed(doubleWorkspace.norm, blocks[0]*blocks[1]);
 
     int visible[2];
     visible[0] = blocks[0]*sbin;
     visible[1] = blocks[1]*sbin;
 
-    for (int x = 1; x < visible[1]-1; x++) {
-      for (int y = 1; y < visible[0]-1; y++) {
-        // first color channel
-        const double *s = im + min(x, dims[1]-2)*dims[0] + min(y, dims[0]-2);
-        double dy = *(s+1) - *(s-1);
-        double dx = *(s+dims[0]) - *(s-dims[0]);
-        double v = dx*dx + dy*dy;
-
-        // second color channel
-        s += dims[0]*dims[1];
-        double dy2 = *(s+1) - *(s-1);
-        double dx2 = *(s+dims[0]) - *(s-dims[0]); //dims[0]=dimY
-        double v2 = dx2*dx2 + dy2*dy2;
-
-        // third color channel
-        s += dims[0]*dims[1];
-        double dy3 = *(s+1) - *(s-1);
-        double dx3 = *(s+dims[0]) - *(s-dims[0]);
-        double v3 = dx3*dx3 + dy3*dy3;
-
-        // pick channel with strongest gradient
-        if (v2 > v) {
-        	v = v2;
-        	dx = dx2;
-        	dy = dy2;
-        }
-        if (v3 > v) {
-        	v = v3;
-        	dx = dx3;
-        	dy = dy3;
+    HOGRegion *region = NULL;
+    if (rects != NULL)
+      region = new HOGRegion(*rects, blocks, out, sbin, visible[0]);
+
+    int numBands = (blocks[0] + BAND_CELLS - 1) / BAND_CELLS;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int band = 0; band < numBands; band++) {
+      int cells[2];
+      int rows[2];
+      getBand(band, blocks, visible, cells, rows);
+      for (int x = 1; x < visible[1]-1; x++) {
+        const char *needed = NULL;
+        if (region != NULL && (needed = region->getRows(x)) == NULL)
+          continue;
+        for (int y = rows[0]; y < rows[1]; y++) {
+          if (needed != NULL && !needed[y])
+            continue;
+          // first color channel
+          const double *s = im + min(x, dims[1]-2)*dims[0] + min(y, dims[0]-2);
+          double dy = *(s+1) - *(s-1);
+          double dx = *(s+dims[0]) - *(s-dims[0]);
+          double v = dx*dx + dy*dy;
+
+          // second color channel
+          s += dims[0]*dims[1];
+          double dy2 = *(s+1) - *(s-1);
+          double dx2 = *(s+dims[0]) - *(s-dims[0]); //dims[0]=dimY
+          double v2 = dx2*dx2 + dy2*dy2;
+
+          // third color channel
+          s += dims[0]*dims[1];
+          double dy3 = *(s+1) - *(s-1);
+          double dx3 = *(s+dims[0]) - *(s-dims[0]);
+          double v3 = dx3*dx3 + dy3*dy3;
+
+          // pick channel with strongest gradient
+          if (v2 > v) {
+          	v = v2;
+          	dx = dx2;
+          	dy = dy2;
+          }
+          if (v3 > v) {
+          	v = v3;
+          	dx = dx3;
+          	dy = dy3;
+          }
+
+          // snap to one of 18 orientations
+          double best_dot = 0;
+          int best_o = 0;
+          for (int o = 0; o < 9; o++) {
+          	double dot = uu[o]*dx + vv[o]*dy;
+          	if (dot > best_dot) {
+          	  best_dot = dot;
+          	  best_o = o;
+          	} else if (-dot > best_dot) {
+          	  best_dot = -dot;
+          	  best_o = o+9;
+          	}
+          }
+
+          // add to 4 histograms(blocks) around pixel using linear interpolation
+          double xp = ((double)x+0.5)/(double)sbin - 0.5;
+          double yp = ((double)y+0.5)/(double)sbin - 0.5;
+          int ixp = (int)floor(xp);
+          int iyp = (int)floor(yp);
+          double vx0 = xp-ixp;
+          double vy0 = yp-iyp;
+          double vx1 = 1.0-vx0;
+          double vy1 = 1.0-vy0;
+          v = sqrt(v);
+
+          // only the cells of the band
+          if (ixp >= 0 && iyp >= cells[0]) {
+          	*(hist + ixp*blocks[0] + iyp + best_o*blocks[0]*blocks[1]) +=
+          	   vx1*vy1*v;
+          }
+
+          if (ixp+1 < blocks[1] && iyp >= cells[0]) {
+          	*(hist + (ixp+1)*blocks[0] + iyp + best_o*blocks[0]*blocks[1]) +=
+          	   vx0*vy1*v;
+          }
+
+          if (ixp >= 0 && iyp+1 < cells[1]) {
+          	*(hist + ixp*blocks[0] + (iyp+1) + best_o*blocks[0]*blocks[1]) +=
+          	   vx1*vy0*v;
+          }
+
+          if (ixp+1 < blocks[1] && iyp+1 < cells[1]) {
+          	*(hist + (ixp+1)*blocks[0] + (iyp+1) + best_o*blocks[0]*blocks[1]) +=
+          	   vx0*vy0*v;
+          }
         }
+      }
+    }
 
-        // snap to one of 18 orientations
-        double best_dot = 0;
-        int best_o = 0;
-        for (int o = 0; o < 9; o++) {
-        	double dot = uu[o]*dx + vv[o]*dy;
-        	if (dot > best_dot) {
-        	  best_dot = dot;
-        	  best_o = o;
-        	} else if (-dot > best_dot) {
-        	  best_dot = -dot;
-        	  best_o = o+9;
-        	}
-        }
+    computeFeatures(hist, norm, blocks, out, region);
+    computeIntegral();
+    delete region;
+  }
+
+#ifdef __SSE2__
+  static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
 
-        // add to 4 histograms(blocks) around pixel using linear interpolation
+  /*
+  Gradient magnitude and orientation bin of the four pixels s[0..3] of a
+  column, dimY apart from their x neighbours, with the same tie breaking as
+  the double kernel.
+   */
+  static void gradients4(const float *s, int dimY, int planeSize,
+                         float *magnitude, int *orientation) {
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(s+1), _mm_loadu_ps(s-1));
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(s+dimY), _mm_loadu_ps(s-dimY));
+    __m128 v = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    for (int ch = 1; ch < 3; ch++) {
+      s += planeSize;
+      __m128 dy2 = _mm_sub_ps(_mm_loadu_ps(s+1), _mm_loadu_ps(s-1));
+      __m128 dx2 = _mm_sub_ps(_mm_loadu_ps(s+dimY), _mm_loadu_ps(s-dimY));
+      __m128 v2 = _mm_add_ps(_mm_mul_ps(dx2, dx2), _mm_mul_ps(dy2, dy2));
+      __m128 stronger = _mm_cmpgt_ps(v2, v);
+      v = select(stronger, v2, v);
+      dx = select(stronger, dx2, dx);
+      dy = select(stronger, dy2, dy);
+    }
+
+    __m128 bestDot = _mm_setzero_ps();
+    __m128 bestO = _mm_setzero_ps();  // bin numbers as integers
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for (int o = 0; o < 9; o++) {
+      __m128 dot = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(uu[o]), dx),
+                              _mm_mul_ps(_mm_set1_ps(vv[o]), dy));
+      __m128 negDot = _mm_xor_ps(dot, sign);
+      __m128 positive = _mm_cmpgt_ps(dot, bestDot);
+      __m128 negative = _mm_andnot_ps(positive, _mm_cmpgt_ps(negDot, bestDot));
+      bestDot = select(positive, dot, select(negative, negDot, bestDot));
+      bestO = select(positive, _mm_castsi128_ps(_mm_set1_epi32(o)),
+                     select(negative, _mm_castsi128_ps(_mm_set1_epi32(o+9)),
+                            bestO));
+    }
+    _mm_storeu_ps(magnitude, _mm_sqrt_ps(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(orientation),
+                     _mm_castps_si128(bestO));
+  }
+#endif
+
+  // scalar version of gradients4 for a single pixel
+  static void gradient(const float *s, int dimY, int planeSize,
+                       float &magnitude, int &orientation) {
+    float dy = *(s+1) - *(s-1);
+    float dx = *(s+dimY) - *(s-dimY);
+    float v = dx*dx + dy*dy;
+    for (int ch = 1; ch < 3; ch++) {
+      s += planeSize;
+      float dy2 = *(s+1) - *(s-1);
+      float dx2 = *(s+dimY) - *(s-dimY);
+      float v2 = dx2*dx2 + dy2*dy2;
+      if (v2 > v) {
+        v = v2;
+        dx = dx2;
+        dy = dy2;
+      }
+    }
+    float best_dot = 0;
+    orientation = 0;
+    for (int o = 0; o < 9; o++) {
+      float dot = (float)uu[o]*dx + (float)vv[o]*dy;
+      if (dot > best_dot) {
+        best_dot = dot;
+        orientation = o;
+      } else if (-dot > best_dot) {
+        best_dot = -dot;
+        orientation = o+9;
+      }
+    }
+    magnitude = sqrtf(v);
+  }
+
+  /*
+  Single precision version of process, used when useFloatKernel is set.
+  The gradients and orientation bins of four pixels of a column are computed
+  at once (SSE2), the bin being picked with compares instead of branches, and
+  the interpolation weights are tabulated per row; only the histogram
+  updates are scalar. The histograms are accumulated in floats. On 8 bit
+  images the gradients are exact and the features differ from those of the
+  double kernel by less than 1e-6; a pixel whose gradient lies within
+  rounding of the border of two orientation bins could go to the other bin,
+  which would change the features of its blocks by up to its share of them.
+   */
+  void process(const float *im, const int *dims,
+               const std::vector<BlockRect> *rects = NULL) {
+    int blocks[2];
+    int out[3];
+    allocateFeatures(dims, blocks, out);
+    float *hist = zeroed(floatWorkspace.hist, blocks[0]*blocks[1]*18);
+    float *norm = zeroed(floatWorkspace.norm, blocks[0]*blocks[1]);
+
+    int visible[2];
+    visible[0] = blocks[0]*sbin;
+    visible[1] = blocks[1]*sbin;
+    int planeSize = dims[0]*dims[1];
+
+    // the interpolation is separable, tabulate it per row
+    std::vector<int> iyps(visible[0]);
+    std::vector<float> vy0s(visible[0]);
+    for (int y = 0; y < visible[0]; y++) {
+      double yp = ((double)y+0.5)/(double)sbin - 0.5;
+      iyps[y] = (int)floor(yp);
+      vy0s[y] = yp-iyps[y];
+    }
+
+    HOGRegion *region = NULL;
+    if (rects != NULL)
+      region = new HOGRegion(*rects, blocks, out, sbin, visible[0]);
+
+    int numBands = (blocks[0] + BAND_CELLS - 1) / BAND_CELLS;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int band = 0; band < numBands; band++) {
+      int cells[2];
+      int rows[2];
+      getBand(band, blocks, visible, cells, rows);
+      float magnitude[4];
+      int orientation[4];
+      for (int x = 1; x < visible[1]-1; x++) {
+        const char *needed = NULL;
+        if (region != NULL && (needed = region->getRows(x)) == NULL)
+          continue;
         double xp = ((double)x+0.5)/(double)sbin - 0.5;
-        double yp = ((double)y+0.5)/(double)sbin - 0.5;
         int ixp = (int)floor(xp);
-        int iyp = (int)floor(yp);
-        double vx0 = xp-ixp;
-        double vy0 = yp-iyp;
-        double vx1 = 1.0-vx0;
-        double vy1 = 1.0-vy0;
-        v = sqrt(v);
-
-        if (ixp >= 0 && iyp >= 0) {
-        	*(hist + ixp*blocks[0] + iyp + best_o*blocks[0]*blocks[1]) +=
-        	   vx1*vy1*v;
+        float vx0 = xp-ixp;
+        const float *column = im + min(x, dims[1]-2)*dims[0];
+        // rows past dims[0]-2 are clamped, leave them to the scalar loop
+        int vectorEnd = min(rows[1], dims[0]-1);
+        for (int y = rows[0]; y < rows[1]; ) {
+          // the next run of needed rows
+          int runEnd = rows[1];
+          if (needed != NULL) {
+            while (y < rows[1] && !needed[y])
+              y++;
+            runEnd = y;
+            while (runEnd < rows[1] && needed[runEnd])
+              runEnd++;
+          }
+#ifdef __SSE2__
+          for (; y + 4 <= min(runEnd, vectorEnd); y += 4) {
+            gradients4(column + y, dims[0], planeSize, magnitude,
+                       orientation);
+            for (int k = 0; k < 4; k++) {
+              addToHistograms(hist, blocks, cells, ixp, iyps[y+k], vx0,
+                              vy0s[y+k], orientation[k], magnitude[k]);
+            }
+          }
+#endif
+          for (; y < runEnd; y++) {
+            gradient(column + min(y, dims[0]-2), dims[0], planeSize,
+                     magnitude[0], orientation[0]);
+            addToHistograms(hist, blocks, cells, ixp, iyps[y], vx0, vy0s[y],
+                            orientation[0], magnitude[0]);
+          }
         }
+      }
+    }
 
-        if (ixp+1 < blocks[1] && iyp >= 0) {
-        	*(hist + (ixp+1)*blocks[0] + iyp + best_o*blocks[0]*blocks[1]) +=
-        	   vx0*vy1*v;
-        }
+    computeFeatures(hist, norm, blocks, out, region);
+    computeIntegral();
+    delete region;
+  }
 
-        if (ixp >= 0 && iyp+1 < blocks[0]) {
-        	*(hist + ixp*blocks[0] + (iyp+1) + best_o*blocks[0]*blocks[1]) +=
-        	   vx1*vy0*v;
-        }
+  // add to 4 histograms(blocks) around pixel using linear interpolation,
+  // of the cell rows cells[0]..cells[1]-1 only
+  static inline void addToHistograms(float *hist, const int *blocks,
+                                     const int *cells, int ixp, int iyp,
+                                     float vx0, float vy0, int o, float v) {
+    float vx1 = 1.0f-vx0;
+    float vy1 = 1.0f-vy0;
+    float *h = hist + ixp*blocks[0] + iyp + o*blocks[0]*blocks[1];
+    if (ixp >= 0 && iyp >= cells[0])
+      *h += vx1*vy1*v;
+    if (ixp+1 < blocks[1] && iyp >= cells[0])
+      *(h + blocks[0]) += vx0*vy1*v;
+    if (ixp >= 0 && iyp+1 < cells[1])
+      *(h + 1) += vx1*vy0*v;
+    if (ixp+1 < blocks[1] && iyp+1 < cells[1])
+      *(h + blocks[0] + 1) += vx0*vy0*v;
+  }
+
+  static const int BAND_CELLS = 8;
+
+  /*
+  The histograms are accumulated in bands of BAND_CELLS cell rows, in
+  parallel. A band gets the pixel rows which add to its cells, including
+  the sbin/2 rows on either side that also add to the neighbouring bands,
+  and only updates its own cells. So each cell is summed in the same order
+  as in a single pass over the image, and the features do not depend on the
+  number of threads, bit for bit.
+   */
+  static void getBand(int band, const int *blocks, const int *visible,
+                      int *cells, int *rows) {
+    cells[0] = band*BAND_CELLS;
+    cells[1] = min(cells[0]+BAND_CELLS, blocks[0]);
+    // pixel y adds to the cells floor((y+0.5)/sbin - 0.5) and the next one
+    rows[0] = max(1, cells[0]*sbin - sbin/2);
+    rows[1] = min(visible[0]-1, cells[1]*sbin + sbin/2);
+  }
+
+  // sizes the blocks of an image of dims and clears feat for them
+  void allocateFeatures(const int *dims, int *blocks, int *out) {
+    blocks[0] = (int)round((double)dims[0]/(double)sbin);
+    blocks[1] = (int)round((double)dims[1]/(double)sbin);
+
+    // memory for HOG features
+    out[0] = max(blocks[0]-2, 0);  // ignore the boundary blocks ?
+    numBlocksOutY=out[0];
+
+    out[1] = max(blocks[1]-2, 0);
+    numBlocksOutX=out[1];
+    // 32 dimensional feature for each block
+    out[2] = HOGFeaturesOfBlock::numFeats ;
+    feat.assign(out[0]*out[1]*out[2], 0);
+  }
 
-        if (ixp+1 < blocks[1] && iyp+1 < blocks[0]) {
-        	*(hist + (ixp+1)*blocks[0] + (iyp+1) + best_o*blocks[0]*blocks[1]) +=
-        	   vx0*vy0*v;
+  // the integral of each feature over the blocks, from feat
+  void computeIntegral() {
+    int sizeY = numBlocksOutY+1;
+    int plane = (numBlocksOutX+1)*sizeY;
+    integral.assign(plane*HOGFeaturesOfBlock::numFeats, 0);
+    if (feat.empty())
+      return;
+#pragma omp parallel for schedule(static)
+    for (int f = 0; f < HOGFeaturesOfBlock::numFeats; f++) {
+      const double *src = &feat[f*numBlocksOutX*numBlocksOutY];
+      double *dst = &integral[f*plane];
+      for (int x = 0; x < numBlocksOutX; x++) {
+        // the integral of column x adds the running sum of the column to
+        // the integral of column x-1
+        double column = 0;
+        for (int y = 0; y < numBlocksOutY; y++) {
+          column += src[x*numBlocksOutY + y];
+          dst[(x+1)*sizeY + y+1] = dst[x*sizeY + y+1] + column;
         }
       }
     }
+  }
 
+  // block energies and normalized features from the orientation histograms,
+  // only for the blocks of region if not NULL
+  template <typename T>
+  void computeFeatures(const T *hist, T *norm, const int *blocks,
+                       const int *out, const HOGRegion *region) {
     // compute energy in each block by summing over orientations
-    for (int o = 0; o < 9; o++) {
-      double *src1 = hist + o*blocks[0]*blocks[1];
-      double *src2 = hist + (o+9)*blocks[0]*blocks[1];
-      double *dst = norm;
-      double *end = norm + blocks[1]*blocks[0];
-      while (dst < end) {
-        *(dst++) += (*src1 + *src2) * (*src1 + *src2);
-        src1++;
-        src2++;
+    int numCells = blocks[0]*blocks[1];
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < numCells; c++) {
+      for (int o = 0; o < 9; o++) {
+        const T *src1 = hist + o*numCells + c;
+        const T *src2 = hist + (o+9)*numCells + c;
+        norm[c] += (*src1 + *src2) * (*src1 + *src2);
       }
     }
 
     // compute features
+#pragma omp parallel for schedule(static)
     for (int x = 0; x < out[1]; x++) {
       for (int y = 0; y < out[0]; y++) {
-        double *dst = feat + x*out[0] + y;
-        double *src, *p, n1, n2, n3, n4;
+        if (region != NULL && !region->isBlockNeeded(x*out[0] + y))
+          continue;
+        double *dst = &feat[x*out[0] + y];
+        const T *src, *p;
+        double n1, n2, n3, n4;
 
         p = norm + (x+1)*blocks[0] + y+1;
         n1 = 1.0 / sqrt(*p + *(p+1) + *(p+blocks[0]) + *(p+blocks[0]+1) + eps);
@@ -418,9 +953,6 @@ public :
         *dst = 0;
       }
     }
-
-    free(hist);
-    free(norm);
   }
 
   int getNumFeatsPerBlock () const {
@@ -440,3 +972,52 @@ double const HOG::uu[9] = {1.0000, .9397, 0.7660, 0.500, 0.1736,
 		                       -0.1736, -0.5000, -0.7660, -0.9397};
 double const HOG::vv[9] = {0.0000, 0.3420, 0.6428, 0.8660, 0.9848,
 		                       0.9848, 0.8660, 0.6428, 0.3420};
+bool HOG::useFloatKernel = false;
+
+/*
+The HOG of the colors of one frame, shared by the features computed from it.
+Each user adds the blocks it needs, and the first get computes the HOG of all
+of them in a single pass.
+ */
+class HOGContext
+{
+ public:
+  HOGContext() : image(NULL, 0, 0, 0, 0, 0, 0), maxValue(1), computed(false) {}
+
+  // starts a frame, image must stay valid until the HOG is computed
+  void reset(const ByteImageView &image_, double maxValue_) {
+    image = image_;
+    maxValue = maxValue_;
+    rects.clear();
+    computed = false;
+  }
+
+  void addBlocks(const BlockRect &rect) {
+    assert(!computed);
+    rects.push_back(rect);
+  }
+
+  // the HOG of the blocks added so far, see HOG::computeHog
+  HOG &get() {
+    if (!computed) {
+      hog.computeHog(image, maxValue, rects);
+      computed = true;
+    }
+    return hog;
+  }
+
+  void swap(HOGContext &other) {
+    std::swap(image, other.image);
+    std::swap(maxValue, other.maxValue);
+    rects.swap(other.rects);
+    std::swap(computed, other.computed);
+    hog.swap(other.hog);
+  }
+
+ private:
+  ByteImageView image;
+  double maxValue;
+  std::vector<BlockRect> rects;
+  bool computed;
+  HOG hog;
+};
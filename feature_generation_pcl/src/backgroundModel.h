@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_BACKGROUNDMODEL_H_
+#define FEATURE_GENERATION_PCL_SRC_BACKGROUNDMODEL_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include "pixel_mask.h"
+
+/*
+Depth background of a sequence recorded with a fixed camera. The background
+of a pixel is the median of the valid (non zero) depth readings among its
+last historyLength frames and is valid while at least half of them were.
+Each call to addFrame first compares the frame against the background built
+from the previous frames and then adds it to the history, so the change mask
+of the first frame of a sequence covers the whole image. A missing reading
+where the background is valid counts as a change.
+ */
+class BackgroundModel {
+ public:
+  BackgroundModel(int width, int height, int historyLength = 9)
+      : width_(width),
+        height_(height),
+        historyLength_(historyLength),
+        numFrames_(0),
+        history_(width * height * historyLength, 0),
+        background_(width * height, 0),
+        validMask_(width, height),
+        changeMask_(width, height) {}
+
+  void reset() {
+    numFrames_ = 0;
+    std::fill(history_.begin(), history_.end(), 0);
+    std::fill(background_.begin(), background_.end(), 0);
+    validMask_.clear();
+    changeMask_.clear();
+  }
+
+  // IMAGE[x][y][3] is the depth, as filled by readData
+  void addFrame(int ***IMAGE) {
+    int slot = numFrames_ % historyLength_;
+    std::vector<uint16_t> samples(historyLength_);
+    changeMask_.clear();
+    for (int y = 0; y < height_; y++) {
+      for (int x = 0; x < width_; x++) {
+        int index = y * width_ + x;
+        int depth = IMAGE[x][y][3];
+        bool changed = (depth > 0)
+            ? (!validMask_.test(index) || isChanged(depth, background_[index]))
+            : validMask_.test(index);
+        if (changed)
+          changeMask_.set(index);
+        uint16_t *h = &history_[index * historyLength_];
+        h[slot] = depth;
+        int numValid = 0;
+        for (int k = 0; k < historyLength_; k++) {
+          if (h[k] > 0)
+            samples[numValid++] = h[k];
+        }
+        if (2 * numValid < std::min(numFrames_ + 1, historyLength_)) {
+          validMask_.reset(index);
+          continue;
+        }
+        validMask_.set(index);
+        std::nth_element(samples.begin(), samples.begin() + numValid / 2,
+                         samples.begin() + numValid);
+        background_[index] = samples[numValid / 2];
+      }
+    }
+    numFrames_++;
+  }
+
+  int getNumFrames() const { return numFrames_; }
+
+  // median depth of the pixel, only meaningful where the valid mask is set
+  int getDepth(int index) const { return background_[index]; }
+
+  const PixelMask &getValidMask() const { return validMask_; }
+
+  // pixels of the last frame which differ from the background
+  const PixelMask &getChangeMask() const { return changeMask_; }
+
+ private:
+  int width_;
+  int height_;
+  int historyLength_;
+  int numFrames_;
+  std::vector<uint16_t> history_;  // historyLength_ samples per pixel
+  std::vector<uint16_t> background_;
+  PixelMask validMask_;
+  PixelMask changeMask_;
+
+  // depth noise of the sensor grows with the distance
+  static bool isChanged(int depth, int background) {
+    return abs(depth - background) > 20 + background / 50;
+  }
+};
+
+#endif  // FEATURE_GENERATION_PCL_SRC_BACKGROUNDMODEL_H_
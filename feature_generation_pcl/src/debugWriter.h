@@ -0,0 +1,179 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_DEBUGWRITER_H_
+#define FEATURE_GENERATION_PCL_SRC_DEBUGWRITER_H_
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <deque>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include <pcl/point_types.h>
+#include <pcl/io/pcd_io.h>
+
+/*
+Writes debug point clouds on a background thread. The per-frame code checks
+whether its frame is sampled and, if so, queues a shared snapshot of the
+cloud, which is written to <directory>/<sequence>_<frame>_<name>.pcd so that
+the dumps of different frames do not overwrite each other. Nothing is
+sampled, and no thread is started, until a sampling policy is set. The queue
+is bounded: enqueue waits while it is full.
+ */
+class DebugWriter {
+ public:
+  typedef pcl::PointCloud<PointT>::ConstPtr CloudConstPtr;
+
+  explicit DebugWriter(const std::string &directory = ".",
+                       size_t maxQueued = 8)
+      : directory_(directory),
+        maxQueued_(maxQueued),
+        everyNthFrame_(0),
+        started_(false),
+        stopping_(false),
+        writing_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&changed_, NULL);
+  }
+
+  // writes whatever is still queued
+  ~DebugWriter() {
+    if (started_) {
+      pthread_mutex_lock(&mutex_);
+      stopping_ = true;
+      pthread_cond_broadcast(&changed_);
+      pthread_mutex_unlock(&mutex_);
+      pthread_join(thread_, NULL);
+    }
+    pthread_cond_destroy(&changed_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  void setDirectory(const std::string &directory) { directory_ = directory; }
+
+  // samples frames 1, 1 + n, 1 + 2n, ...
+  void setEveryNthFrame(int n) { everyNthFrame_ = n; }
+
+  void addFrame(int frameNum) { frames_.insert(frameNum); }
+
+  /*
+  Once a sequence is added only the added sequences are sampled, all their
+  frames if no frame or stride is set.
+   */
+  void addSequence(const std::string &sequenceId) {
+    sequences_.insert(sequenceId);
+  }
+
+  bool isSampled(const std::string &sequenceId, int frameNum) const {
+    if (!sequences_.empty() && sequences_.count(sequenceId) == 0)
+      return false;
+    if (frames_.empty() && everyNthFrame_ <= 0)
+      return !sequences_.empty();
+    if (frames_.count(frameNum) > 0)
+      return true;
+    return everyNthFrame_ > 0 && (frameNum - 1) % everyNthFrame_ == 0;
+  }
+
+  /*
+  Parses --debug-every=<n>, --debug-frame=<n>, --debug-sequence=<id> and
+  --debug-dir=<directory>. Returns false for any other option.
+   */
+  bool parseOption(const std::string &option) {
+    std::string value;
+    if (hasPrefix(option, "--debug-every=", value)) {
+      setEveryNthFrame(atoi(value.c_str()));
+    } else if (hasPrefix(option, "--debug-frame=", value)) {
+      addFrame(atoi(value.c_str()));
+    } else if (hasPrefix(option, "--debug-sequence=", value)) {
+      addSequence(value);
+    } else if (hasPrefix(option, "--debug-dir=", value)) {
+      setDirectory(value);
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  void enqueue(const std::string &sequenceId, int frameNum,
+               const std::string &name, const CloudConstPtr &cloud) {
+    std::stringstream filename;
+    filename << directory_ << "/" << sequenceId << "_" << frameNum << "_"
+             << name << ".pcd";
+    Job job;
+    job.filename = filename.str();
+    job.cloud = cloud;
+    pthread_mutex_lock(&mutex_);
+    if (!started_) {
+      started_ = true;
+      pthread_create(&thread_, NULL, &DebugWriter::run, this);
+    }
+    while (queue_.size() >= maxQueued_)
+      pthread_cond_wait(&changed_, &mutex_);
+    queue_.push_back(job);
+    pthread_cond_broadcast(&changed_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  // waits until everything queued so far is written
+  void flush() {
+    pthread_mutex_lock(&mutex_);
+    while (!queue_.empty() || writing_)
+      pthread_cond_wait(&changed_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+ private:
+  struct Job {
+    std::string filename;
+    CloudConstPtr cloud;
+  };
+
+  std::string directory_;
+  size_t maxQueued_;
+  int everyNthFrame_;
+  std::set<int> frames_;
+  std::set<std::string> sequences_;
+
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t changed_;  // the queue or stopping_ changed
+  std::deque<Job> queue_;
+  bool started_;
+  bool stopping_;
+  bool writing_;
+
+  static bool hasPrefix(const std::string &option, const std::string &prefix,
+                        std::string &value) {
+    if (option.compare(0, prefix.size(), prefix) != 0)
+      return false;
+    value = option.substr(prefix.size());
+    return true;
+  }
+
+  static void *run(void *self) {
+    DebugWriter *writer = static_cast<DebugWriter *>(self);
+    pthread_mutex_lock(&writer->mutex_);
+    while (true) {
+      while (writer->queue_.empty() && !writer->stopping_)
+        pthread_cond_wait(&writer->changed_, &writer->mutex_);
+      if (writer->queue_.empty())
+        break;
+      Job job = writer->queue_.front();
+      writer->queue_.pop_front();
+      writer->writing_ = true;
+      pthread_cond_broadcast(&writer->changed_);
+      pthread_mutex_unlock(&writer->mutex_);
+      pcl::io::savePCDFileBinary(job.filename, *job.cloud);
+      pthread_mutex_lock(&writer->mutex_);
+      writer->writing_ = false;
+      pthread_cond_broadcast(&writer->changed_);
+    }
+    pthread_mutex_unlock(&writer->mutex_);
+    return NULL;
+  }
+};
+
+#endif  // FEATURE_GENERATION_PCL_SRC_DEBUGWRITER_H_
@@ -28,6 +28,7 @@ typedef pcl::PointXYZRGB PointT;
 
 #include "includes/color.h"
 #include "frame.cpp"
+#include "backgroundModel.h"
 
 using namespace std;
 
@@ -54,6 +55,10 @@ map<string, vector<string> > data_obj_type_map;
 map<string, set<int> > FrameList;
 string dataLocation;
 string actfile;
+// fit the table plane with RANSAC instead of clustering the filtered cloud
+bool useRansacTable = false;
+// reproject and search for the table only where the scene changed
+bool useBackground = false;
 
 // print error message
 
@@ -153,25 +158,38 @@ void readDataActMapOld() {
 
 
 
-void saveTablePC( pcl::PointCloud<PointT> &cloud, pcl::PointIndices &tablePointInds) {
-  if(tablePointInds.indices.size() > 1){
-    pcl::PointCloud<PointT> table;
-    table.height = 1;
-    table.width = tablePointInds.indices.size();
-    table.points.resize(table.height * table.width);
-    for(int i = 0; i < tablePointInds.indices.size(); i ++){
-      table.points.at(i).x = cloud.points.at(tablePointInds.indices.at(i)).x;
-      table.points.at(i).y = cloud.points.at(tablePointInds.indices.at(i)).y;
-      table.points.at(i).z = cloud.points.at(tablePointInds.indices.at(i)).z;
-      table.points.at(i).rgb = cloud.points.at(tablePointInds.indices.at(i)).rgb;
+// queues the table points of a sampled frame to the debug writer
+void saveTablePC(pcl::PointCloud<PointT> &cloud, PixelMask &tablePoints,
+                 string sequenceId, int frameNum) {
+  if (!Frame::debugWriter.isSampled(sequenceId, frameNum)) {
+    return;
+  }
+  vector<int> tablePointInds;
+  tablePoints.getIndices(tablePointInds);
+  if(tablePointInds.size() > 1){
+    pcl::PointCloud<PointT>::Ptr table(new pcl::PointCloud<PointT>);
+    table->height = 1;
+    table->width = tablePointInds.size();
+    table->points.resize(table->height * table->width);
+    for(int i = 0; i < tablePointInds.size(); i ++){
+      table->points.at(i) = cloud.points.at(tablePointInds.at(i));
     }
-    pcl::io::savePCDFile("table.pcd", table);
+    Frame::debugWriter.enqueue(sequenceId, frameNum, "table", table);
   }
 }
 
+void projectPixel(int ***IMAGE, int x, int y, ColorRGB &color,
+                  PointT &point) {
+  color.assignColor(float(IMAGE[x][y][0]) / 255.0, float(IMAGE[x][y][1]) / 255, float(IMAGE[x][y][2]) / 255);
+  point.y = IMAGE[x][y][3];
+  point.x = (x - 640 * 0.5) * point.y * 1.1147 / 640;
+  point.z = (480 * 0.5 - y) * point.y * 0.8336 / 480;
+  point.rgb = color.getFloatRep();
+}
+
 void createPointCloud(int ***IMAGE, string transformfile,
                       pcl::PointCloud<PointT> &cloud,
-                      map<int, int> &tablePoints) {
+                      PixelMask &tablePoints) {
   int index = 0;
   ColorRGB color(0, 0, 0);
 
@@ -181,11 +199,7 @@ void createPointCloud(int ***IMAGE, string transformfile,
 
   for (int y = 0; y < Y_RES; y++) {
     for (int x = 0; x < X_RES; x++) {
-      color.assignColor(float(IMAGE[x][y][0]) / 255.0, float(IMAGE[x][y][1]) / 255, float(IMAGE[x][y][2]) / 255);
-      cloud.points.at(index).y = IMAGE[x][y][3];
-      cloud.points.at(index).x = (x - 640 * 0.5) * cloud.points.at(index).y * 1.1147 / 640;
-      cloud.points.at(index).z = (480 * 0.5 - y) * cloud.points.at(index).y * 0.8336 / 480;
-      cloud.points.at(index).rgb = color.getFloatRep();
+      projectPixel(IMAGE, x, y, color, cloud.points.at(index));
       index++;
     }
   }
@@ -195,14 +209,85 @@ void createPointCloud(int ***IMAGE, string transformfile,
   globalTransform.transformPointCloudInPlaceAndSetOrigin(cloud);
   // find table indices
   pcl::PointIndices tablePointInds;
-  getTableInds(cloud, tablePointInds);
+  getTableInds(cloud, tablePointInds, useRansacTable);
   cout << "size of table :" << tablePointInds.indices.size() << endl;
-  for (size_t i = 0; i < tablePointInds.indices.size(); i++)
-    tablePoints[tablePointInds.indices.at(i)] = 1;
+  tablePoints.resize(X_RES, Y_RES);
+  tablePoints.set(tablePointInds.indices);
 }
 
 
-void filterCloud(pcl::PointCloud<PointT> &cloud, map<int, int> &tablePoints,
+// keeps the RGBD values of every pixel, which its point is projected from
+void saveProjectedImage(int ***IMAGE, vector<int> &projectedImage) {
+  projectedImage.resize(X_RES * Y_RES * RGBD_data);
+  for (int y = 0; y < Y_RES; y++) {
+    for (int x = 0; x < X_RES; x++) {
+      int *values = &projectedImage[(y * X_RES + x) * RGBD_data];
+      for (int c = 0; c < RGBD_data; c++) {
+        values[c] = IMAGE[x][y][c];
+      }
+    }
+  }
+}
+
+/*
+Background mode: after the first frame of a sequence only the pixels whose
+depth or color differs from the values their point was projected from are
+projected again, so the cloud is the same as createPointCloud would give.
+The table found on the first frame is reused, without the pixels which
+differ from the background, until a quarter of it has changed. The objects
+are still clustered in full by the caller.
+ */
+void updatePointCloud(int ***IMAGE, string transformfile,
+                      TransformG &globalTransform,
+                      const BackgroundModel &background,
+                      pcl::PointCloud<PointT> &cloud,
+                      vector<int> &projectedImage,
+                      PixelMask &cachedTable, PixelMask &tablePoints) {
+  if (background.getNumFrames() <= 1) {
+    createPointCloud(IMAGE, transformfile, cloud, cachedTable);
+    saveProjectedImage(IMAGE, projectedImage);
+    tablePoints = cachedTable;
+    return;
+  }
+  ColorRGB color(0, 0, 0);
+  int numReprojected = 0;
+  for (int y = 0; y < Y_RES; y++) {
+    for (int x = 0; x < X_RES; x++) {
+      int index = y * X_RES + x;
+      int *values = &projectedImage[index * RGBD_data];
+      bool changed = false;
+      for (int c = 0; c < RGBD_data; c++) {
+        if (values[c] != IMAGE[x][y][c]) {
+          values[c] = IMAGE[x][y][c];
+          changed = true;
+        }
+      }
+      if (!changed) {
+        continue;
+      }
+      PointT &point = cloud.points.at(index);
+      projectPixel(IMAGE, x, y, color, point);
+      globalTransform.transformPointInPlace(point);
+      numReprojected++;
+    }
+  }
+  cout << "reprojected pixels :" << numReprojected << endl;
+
+  const PixelMask &changed = background.getChangeMask();
+  PixelMask changedTable = cachedTable;
+  changedTable.intersectWith(changed);
+  if (4 * changedTable.count() > cachedTable.count()) {
+    pcl::PointIndices tablePointInds;
+    getTableInds(cloud, tablePointInds, useRansacTable);
+    cout << "size of table :" << tablePointInds.indices.size() << endl;
+    cachedTable.clear();
+    cachedTable.set(tablePointInds.indices);
+  }
+  tablePoints = cachedTable;
+  tablePoints.subtract(changed);
+}
+
+void filterCloud(pcl::PointCloud<PointT> &cloud, PixelMask &tablePoints,
                  string transformfile, pcl::PointIndices & objIndices,
                  pcl::PointXYZ &centroid ) {
   PointT origin;
@@ -223,7 +308,7 @@ void filterCloud(pcl::PointCloud<PointT> &cloud, map<int, int> &tablePoints,
 
     if (dist_from_cam < 3500 && dist_from_cam > 0 )
     {
-      if( tablePoints.find(i) == tablePoints.end()) {
+      if (!tablePoints.test(i)) {
         indices.push_back(i);
       }
     }
@@ -258,7 +343,7 @@ void checkIndices(pcl::PointCloud<PointT> & cloud,
   }
 }
 
-int getObjectPointCloud(pcl::PointCloud<PointT> &fullcloud, map<int, int> &tablePoints, string transformfile, vector<double> features, pcl::PointIndices &objIndices, string fn, pcl::PointXYZ &centroid ) {
+int getObjectPointCloud(pcl::PointCloud<PointT> &fullcloud, PixelMask &tablePoints, string transformfile, vector<double> features, pcl::PointIndices &objIndices, string sequenceId, int frameNum, string name, pcl::PointXYZ &centroid ) {
   double minX = features.at(2);
   double minY = features.at(3);
   double maxX = features.at(4);
@@ -272,32 +357,31 @@ int getObjectPointCloud(pcl::PointCloud<PointT> &fullcloud, map<int, int> &table
   cloud.width = (maxY - minY + 1)*(maxX - minX + 1);
   cloud.points.resize(cloud.height * cloud.width);
   cout << "width" << cloud.width << endl;
-  map<int, int> localTablePoints;
+  PixelMask localTablePoints(cloud.width, 1);
 
-  int objIndex = 0;
+  // gather the non-table pixels of the box, row by row
   for (int y = minY; y <= maxY; y++) {
-    for (int x = minX; x <= maxX; x++) {
-      index = y * X_RES + x - 1;
-      if (tablePoints.find(index) == tablePoints.end()) {
-        cloud.points.at(objIndex) = fullcloud.points.at(index);
-        objIndices.indices.push_back(index);
-        objIndex++;
-      }
-    }
+    index = y * X_RES + static_cast<int>(minX) - 1;
+    tablePoints.getIndicesInRange(index, index + static_cast<int>(maxX)
+                                  - static_cast<int>(minX) + 1, false,
+                                  objIndices.indices);
+  }
+  int objIndex = objIndices.indices.size();
+  for (int i = 0; i < objIndex; i++) {
+    cloud.points.at(i) = fullcloud.points.at(objIndices.indices.at(i));
   }
   cloud.width = objIndices.indices.size();
   cloud.points.resize(objIndices.indices.size());
-  cout << "cloud size : " << cloud.points.size() << " indices : " << objIndices.indices.size() << "objindex : " << objIndex<< " tablepoints: " << localTablePoints.size() <<  endl;
+  cout << "cloud size : " << cloud.points.size() << " indices : " << objIndices.indices.size() << "objindex : " << objIndex<< " tablepoints: " << localTablePoints.count() <<  endl;
   if(cloud.points.size()>10){
     filterCloud(cloud,localTablePoints, transformfile, objIndices, centroid);
     cout << "size after filtering:" << objIndices.indices.size() << endl;
     checkIndices(cloud,fullcloud,objIndices);
   }
-  string filename;
-  //sprintf(filename, "%s_obj_%d.pcd",aid, objID);
-  filename = "pointclouds/"+fn;
-  pcl::io::savePCDFileBinary(filename, cloud);
-  std::cerr << "Saved " << cloud.points.size() << " data points to " << filename << std::endl;
+  if (Frame::debugWriter.isSampled(sequenceId, frameNum)) {
+    pcl::PointCloud<PointT>::Ptr snapshot(new pcl::PointCloud<PointT>(cloud));
+    Frame::debugWriter.enqueue(sequenceId, frameNum, name, snapshot);
+  }
   return 1;
 }
 
@@ -309,6 +393,16 @@ int main(int argc, char** argv) {
   dataLocation =  (string)argv[1] + "/";
   string mirrored_dataLocation = "";
   actfile = (string)argv[2];
+  for (int a = 3; a < argc; a++) {
+    string option = (string)argv[a];
+    if (option.compare("ransac") == 0) {
+      useRansacTable = true;
+    } else if (option.compare("background") == 0) {
+      useBackground = true;
+    } else {
+      Frame::debugWriter.parseOption(option);
+    }
+  }
   readDataActMap();
   // get all names of file from the map
   vector<string> all_files;
@@ -371,23 +465,34 @@ int main(int argc, char** argv) {
      for(int o = 0; o < objData.size(); o++){
        centroids.push_back(centroidP);
      }
+     BackgroundModel background(X_RES, Y_RES);
+     TransformG globalTransform;
+     if (useBackground) {
+       globalTransform = readTranform(transformfile);
+     }
+     pcl::PointCloud<PointT> cloud;
+     vector<int> projectedImage;
+     PixelMask cachedTable(X_RES, Y_RES);
      while (status > 0) {
         // create point cloud
-        pcl::PointCloud<PointT> cloud;
-        map<int, int> tablePoints;
-        createPointCloud(IMAGE, transformfile, cloud, tablePoints);
+        PixelMask tablePoints;
+        if (useBackground) {
+          background.addFrame(IMAGE);
+          updatePointCloud(IMAGE, transformfile, globalTransform, background,
+                           cloud, projectedImage, cachedTable, tablePoints);
+        } else {
+          createPointCloud(IMAGE, transformfile, cloud, tablePoints);
+        }
+        saveTablePC(cloud, tablePoints, all_files[i], status);
         // for each object find the object point cloud
         for (size_t o = 0; o < objData.size(); o++) {
           pcl::PointIndices cloudInds;
-          stringstream fn;
-          fn << all_files[i] + "_frame_";
-          fn << status;
-          fn << "_obj_";
-          fn << o;
-          fn << ".pcd";
+          stringstream name;
+          name << "obj_" << o;
           pcl::PointXYZ centroid = centroids.at(o);
           int rval = getObjectPointCloud(cloud, tablePoints, transformfile,
-                                         objData.at(o), cloudInds, fn.str(),
+                                         objData.at(o), cloudInds,
+                                         all_files[i], status, name.str(),
                                          centroid);
           centroids.at(o) = centroid;
           // write the object point cloud indices.
@@ -415,6 +520,7 @@ int main(int argc, char** argv) {
       }
     }
   }
+  Frame::debugWriter.flush();
   printf("ALL DONE.\n\n");
   return 0;
 }
@@ -22,6 +22,7 @@ Copyright (C) 2012 Hema Koppula
 typedef pcl::PointXYZRGB PointT;
 #include "includes/point_types.h"
 #include "includes/CombineUtils.h"
+#include "skeletonImputer.h"
 
 #include "readData.cpp"
 #include "frame.cpp"
@@ -248,11 +249,16 @@ int main(int argc, char** argv) {
   string actfile =  (string)argv[2];
   string mirrored_dataLocation = "";
   bool compressed = false;
-  if (argc >= 3){
-  	string c = (string)argv[3];
-  	if (c.compare("compressed")==0){
-  		compressed = true;
-  	}
+  ObjectTracker objectTracker;
+  for (int a = 3; a < argc; a++) {
+    string option = (string)argv[a];
+    if (option.compare("compressed") == 0) {
+      compressed = true;
+    } else if (!objectTracker.parseOption(option) &&
+               !Frame::parseObjectMode(option) &&
+               !HOG::parseKernelOption(option)) {
+      Frame::debugWriter.parseOption(option);
+    }
   }
   readDataActMap(actfile);
   readSegmentsFile();
@@ -295,6 +301,7 @@ int main(int argc, char** argv) {
   vector<vector<double> > objData;
   vector<vector<int> > objPCInds;
   string lastActId = "0";
+  SkeletonImputer imputer;
   for (size_t i = 0; i < all_files.size(); i++) {
     int count = 1;
     vector <string> fileList(data_obj_map[all_files.at(i)].size());
@@ -320,27 +327,44 @@ int main(int argc, char** argv) {
       int status = DATA->readNextFrame(data, pos_data, data_CONF, pos_data_CONF,
                                        IMAGE, objData, objPCInds);
       FrameFeatures ff(true);
-      list<Frame> frames;
 
       int oldSegNum = 1;
       while (status > 0) {
-        Frame frame(IMAGE, data, pos_data, objData, all_files[i], status, transformfile, objPCInds);
-        frames.push_back(frame);
-        if(frames.size()>2) {
-          frames.pop_front();
+        imputer.startFrame(all_files[i]);
+        bool tracked = imputer.impute(data, pos_data, data_CONF, pos_data_CONF);
+        Frame frame;
+        if (objectTracker.enabled()) {
+          // the objects are clustered from their boxes, following their
+          // clusters of the previous frame
+          Frame tracked(IMAGE, data, pos_data, objData, all_files[i], status,
+                        transformfile, &objectTracker);
+          frame.swap(tracked);
+        } else {
+          Frame extracted(IMAGE, data, pos_data, objData, all_files[i],
+                          status, transformfile, objPCInds);
+          frame.swap(extracted);
         }
+        frame.skeleton.setTracking(data_CONF, pos_data_CONF, tracked);
         if (lastActId.compare(frame.sequenceId) != 0) {
           cout << "activity changed, new id : " << frame.sequenceId << endl;
           lastActId = frame.sequenceId;
           ff.resetActivity();
         }
-        ff.setCurrentFrames(frames,status);
+        ff.addFrame(frame, status);
         ff.computeFreatures(true);
         status = DATA->readNextFrame(data, pos_data, data_CONF, pos_data_CONF, IMAGE, objData, objPCInds);
         count++;
       }
     }
   }
+  if (Frame::objectMode == OBJECT_MODE_VALIDATE) {
+    Frame::objectModeStats.print(cout);
+  }
+  if (objectTracker.enabled()) {
+    objectTracker.print(cout);
+  }
+  imputer.print(cout);
+  Frame::debugWriter.flush();
   printf("ALL DONE.\n\n");
   return 0;
 }
@@ -21,6 +21,7 @@ Copyright (C) 2012 Hema Koppula
 typedef pcl::PointXYZRGB PointT;
 #include "includes/point_types.h"
 #include "includes/CombineUtils.h"
+#include "skeletonImputer.h"
 
 #include "readData.cpp"
 #include "frame.cpp"
@@ -51,9 +52,24 @@ map<string, string> data_act_map;
 map<string, vector<string> > data_obj_map;
 map<string, vector<string> > data_obj_type_map;
 map<string, set<int> > FrameList;
-map<string, map< int, set<int> > > SegmentList;
 string dataLocation;
 
+/*
+The segment features of one segmentation file. With a single file they are
+written to the data_*.txt files, with several to <file name>_data_*.txt.
+ */
+struct SegmentationFeatures {
+  string segmentationFile;
+  string prefix;
+  // the segment of every frame of every activity, 0 for the frames in none
+  map<string, vector<int> > frameSegments;
+  string lastActId;
+  // those of the activity being read
+  FeaturesMultiFrame *fmf;
+  vector<Frame> segment;
+  int oldSegNum;
+};
+
 // print error message
 
 void errorMsg(string message) {
@@ -67,10 +83,28 @@ void parseChk(bool chk) {
   }
 }
 
-void readSegmentsFile() {
+// a frame listed in several segments belongs to the first of them
+void setCluster(map<string, vector<int> > &frameSegments, const string &id,
+                int frameNum, int cluster) {
+  if (frameNum < 0) {
+    return;
+  }
+  vector<int> &segments = frameSegments[id];
+  if (frameNum >= (int)segments.size()) {
+    segments.resize(frameNum + 1, 0);
+  }
+  if (segments[frameNum] == 0 || cluster < segments[frameNum]) {
+    segments[frameNum] = cluster;
+  }
+}
+
+void readSegmentsFile(const string &labelfile,
+                      map<string, vector<int> > &frameSegments) {
   //const string labelfile = dataLocation + "Segmentation.txt";
-  const string labelfile =  "Segmentation_sampled.txt";
   ifstream file((char*) labelfile.c_str(), ifstream::in);
+  if (!file.is_open()) {
+    errorMsg("cannot open segmentation file " + labelfile);
+  }
   string line;
   int count = 0;
   while (getline(file, line)) {
@@ -91,13 +125,13 @@ void readSegmentsFile() {
       while (pos!=string::npos){
         int fnum = atoi( rest.substr(0,pos).c_str() );
         cout << fnum << ",";
-        SegmentList[element1][cluster].insert(fnum);
+        setCluster(frameSegments, element1, fnum, cluster);
         rest = rest.substr(pos+1);
         pos = rest.find_first_of(',');
       }
       int fnum = atoi( rest.substr(0,pos).c_str() );
       cout << fnum << ",";
-      SegmentList[element1][cluster].insert(fnum);
+      setCluster(frameSegments, element1, fnum, cluster);
       cout << endl;
     }
     cout << "\t" << element1  << endl;
@@ -227,13 +261,12 @@ void printData(FILE* pRecFile, int * feats, int numFeats) {
   }
 }
 
-int getCluster(int frameNum, string id) {
-  for (map< int, set<int> >::iterator i = SegmentList[id].begin(); i != SegmentList[id].end(); i++) {
-    if (i->second.find(frameNum) != i->second.end()) {
-      return i->first;
-    }
+// segments are the frameSegments of the activity
+int getCluster(int frameNum, const vector<int> &segments) {
+  if (frameNum < 0 || frameNum >= (int)segments.size()) {
+    return 0;
   }
-  return 0;
+  return segments[frameNum];
 }
 
 /*
@@ -243,8 +276,39 @@ int main(int argc, char** argv) {
   dataLocation = (string)argv[1] + "/";
   string actfile =  (string)argv[2];
   string mirrored_dataLocation = "";
+  vector<SegmentationFeatures> segmentations;
+  ObjectTracker objectTracker;
+  for (int a = 3; a < argc; a++) {
+    string option = (string)argv[a];
+    if (option.compare(0, 15, "--segmentation=") == 0) {
+      segmentations.push_back(SegmentationFeatures());
+      segmentations.back().segmentationFile = option.substr(15);
+    } else if (!objectTracker.parseOption(option) &&
+               !Frame::parseObjectMode(option) &&
+               !HOG::parseKernelOption(option)) {
+      Frame::debugWriter.parseOption(option);
+    }
+  }
+  if (segmentations.empty()) {
+    segmentations.push_back(SegmentationFeatures());
+    segmentations.back().segmentationFile = "Segmentation_sampled.txt";
+  }
   readDataActMap(actfile);
-  readSegmentsFile();
+  set<string> prefixes;
+  for (size_t k = 0; k < segmentations.size(); k++) {
+    SegmentationFeatures &seg = segmentations[k];
+    if (segmentations.size() > 1) {
+      // the file name without its directory and extension
+      string name = seg.segmentationFile.substr(
+          seg.segmentationFile.find_last_of('/') + 1);
+      seg.prefix = name.substr(0, name.find_last_of('.')) + "_";
+      if (!prefixes.insert(seg.prefix).second) {
+        errorMsg("two segmentation files named " + name);
+      }
+    }
+    readSegmentsFile(seg.segmentationFile, seg.frameSegments);
+    seg.lastActId = "0";
+  }
   // get all names of file from the map
   vector<string> all_files;
   map<string, string>::iterator it = data_act_map.begin();
@@ -280,7 +344,9 @@ int main(int argc, char** argv) {
   }
   vector<vector<double> > objData;
   vector<vector<int> > objPCInds;
-  string lastActId = "0";
+  SkeletonImputer imputer;
+  // the frames in a segment of any segmentation
+  vector<int> segmentFrames;
   for (size_t i = 0; i < all_files.size(); i++) {
     int count = 1;
 
@@ -295,6 +361,17 @@ int main(int argc, char** argv) {
                               + "_obj" + data_obj_map[all_files.at(i)].at(j)
                               + ".txt";
     }
+    segmentFrames.clear();
+    for (size_t k = 0; k < segmentations.size(); k++) {
+      const vector<int> &frameSegments =
+          segmentations[k].frameSegments[all_files[i]];
+      if (frameSegments.size() > segmentFrames.size()) {
+        segmentFrames.resize(frameSegments.size(), 0);
+      }
+      for (size_t f = 0; f < frameSegments.size(); f++) {
+        segmentFrames[f] |= (frameSegments[f] != 0);
+      }
+    }
     // for both mirrored and non mirrored data make j<2 ; for now use only mirrored
     for (int j = 0; j < 1; j++) {
       Frame::FrameNum = 0;
@@ -304,45 +381,104 @@ int main(int argc, char** argv) {
       readData* DATA = new readData(dataLocation, all_files[i], data_act_map,
                                     i + 1, mirrored, mirrored_dataLocation,
                                     skipOdd, fileList, objPCFileList);
+      // only the images of the frames in a segment are read, and no frame
+      // after the last of them
+      int lastSegmentFrame = segmentFrames.size() - 1;
       int status = DATA->readNextFrame(data, pos_data, data_CONF, pos_data_CONF,
-                                       IMAGE, objData, objPCInds);
-      FeaturesMultiFrame fmf(true);
-      vector<Frame> segment;
-      int oldSegNum = 1;
+                                       IMAGE, objData, objPCInds,
+                                       &segmentFrames);
+      for (size_t k = 0; k < segmentations.size(); k++) {
+        segmentations[k].fmf = new FeaturesMultiFrame(true,
+                                                      segmentations[k].prefix);
+        segmentations[k].segment.clear();
+        segmentations[k].oldSegNum = 1;
+      }
       while (status > 0) {
-        // if the frame belongs to a segment
-        int segNum =  getCluster(status, all_files[i]);
-        if (segNum != 0) {
-
-          Frame frame (IMAGE, data, pos_data, objData, all_files[i], status,
-                       transformfile, objPCInds);
-          // if segment changed
-          if (segNum != oldSegNum && segNum !=0) {
-            cout << "segment changed, new id : " << segNum << endl;
-            fmf.setCurrentSegment(segment, oldSegNum);
-            fmf.computeFreatures(true);
-            segment.clear();
-            oldSegNum = segNum;
+        // every frame is imputed, so that the gaps are bridged from the last
+        // tracked frame even if it was outside of the segments
+        imputer.startFrame(all_files[i]);
+        bool tracked = imputer.impute(data, pos_data, data_CONF,
+                                      pos_data_CONF);
+        // if the frame belongs to a segment of any segmentation, it is
+        // computed once and handed to each of them
+        if (getCluster(status, segmentFrames) != 0) {
+
+          Frame frame;
+          if (objectTracker.enabled()) {
+            // the objects are clustered from their boxes, following their
+            // clusters of the previous frame
+            Frame tracked(IMAGE, data, pos_data, objData, all_files[i], status,
+                          transformfile, &objectTracker);
+            frame.swap(tracked);
+          } else {
+            Frame extracted(IMAGE, data, pos_data, objData, all_files[i],
+                            status, transformfile, objPCInds);
+            frame.swap(extracted);
+          }
+          frame.skeleton.setTracking(data_CONF, pos_data_CONF, tracked);
+          int lastUser = -1;
+          for (size_t k = 0; k < segmentations.size(); k++) {
+            if (getCluster(status, segmentations[k].frameSegments[all_files[i]])
+                != 0) {
+              lastUser = k;
+            }
           }
-          if (lastActId.compare(frame.sequenceId) != 0) {
-            cout << "activity changed, new id : " << frame.sequenceId << endl;
-            lastActId = frame.sequenceId;
-            fmf.resetActivity();
-            segment.clear();
+          for (int k = 0; k <= lastUser; k++) {
+            SegmentationFeatures &seg = segmentations[k];
+            int segNum = getCluster(status, seg.frameSegments[all_files[i]]);
+            if (segNum == 0) {
+              continue;
+            }
+            // if segment changed
+            if (segNum != seg.oldSegNum && segNum !=0) {
+              cout << "segment changed, new id : " << segNum << endl;
+              seg.fmf->setCurrentSegment(seg.segment, seg.oldSegNum);
+              seg.fmf->computeFreatures(true);
+              seg.segment.clear();
+              seg.oldSegNum = segNum;
+            }
+            if (seg.lastActId.compare(frame.sequenceId) != 0) {
+              cout << "activity changed, new id : " << frame.sequenceId << endl;
+              seg.lastActId = frame.sequenceId;
+              seg.fmf->resetActivity();
+              seg.segment.clear();
+            }
+            seg.segment.push_back(Frame());
+            // the last segmentation takes the frame, the others a copy
+            if (k == lastUser) {
+              seg.segment.back().swap(frame);
+            } else {
+              frame.copySegmentData(seg.segment.back());
+            }
           }
-          segment.push_back(frame);
         }
         bool started;
 
+        if (status >= lastSegmentFrame) {
+          break;
+        }
         status = DATA->readNextFrame(data, pos_data, data_CONF, pos_data_CONF,
-                                     IMAGE, objData, objPCInds);
+                                     IMAGE, objData, objPCInds,
+                                     &segmentFrames);
 
         count++;
       }
+      for (size_t k = 0; k < segmentations.size(); k++) {
+        delete segmentations[k].fmf;
+        segmentations[k].fmf = NULL;
+      }
     }
   }
  // fclose(pRecFile);
 
+  if (Frame::objectMode == OBJECT_MODE_VALIDATE) {
+    Frame::objectModeStats.print(cout);
+  }
+  if (objectTracker.enabled()) {
+    objectTracker.print(cout);
+  }
+  imputer.print(cout);
+  Frame::debugWriter.flush();
   printf("ALL DONE.\n\n");
 
   return 0;
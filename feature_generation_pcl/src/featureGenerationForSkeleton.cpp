@@ -0,0 +1,200 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+/*
+Skeleton features of every frame of every activity, from the skeleton files
+alone: no RGBD data is read and no point clouds or HOG are computed. Writes
+data_skel_feats.txt, data_temporal_skel_feats.txt and
+data_skel_untracked.txt in the formats of frameFeatgen.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <vector>
+
+#include <pcl/point_types.h>
+#include "constants.h"
+#include "skeletonImputer.h"
+
+#include "readData.cpp"
+#include "frame_skel.cpp"
+#include "features.cpp"
+
+using namespace std;
+
+map<string, string> data_act_map;
+string dataLocation;
+
+void errorMsg(string message) {
+  cout << "ERROR! " << message << endl;
+  exit(1);
+}
+
+void parseChk(bool chk) {
+  if (!chk) {
+    errorMsg("parsing error.");
+  }
+}
+
+// only the activity ids are needed, the objects are skipped
+void readDataActMap(string actfile) {
+  const string mapfile = dataLocation + actfile;
+  printf("Opening map of data to activity: \"%s\"\n",
+          (char*) mapfile.c_str());
+  ifstream file((char*) mapfile.c_str(), ifstream::in);
+
+  string line;
+  int count = 0;
+  while (getline(file, line)) {
+    stringstream lineStream(line);
+    string element1, element2;
+    parseChk(getline(lineStream, element1, ','));
+    if (element1.compare("END") == 0) {
+      break;
+    }
+    parseChk(getline(lineStream, element2, ','));
+    if (element1.length() != 10) {
+      errorMsg("Data Act Map file format mismatch..");
+    }
+    data_act_map[element1] = element2;
+    cout << "\t" << element1 << " : " << data_act_map[element1] << endl;
+    count++;
+  }
+  file.close();
+
+  if (count == 0) {
+    errorMsg("File does not exist or is empty!\n");
+  }
+  printf("\tcount = %d\n\n", count);
+}
+
+void printFeats(const vector<double> &feats, std::ofstream &file) {
+  for (size_t i = 0; i < feats.size(); i++) {
+    file << "," << feats.at(i);
+  }
+  file << endl;
+}
+
+// as FrameFeatures::computeSkelTemporalFeatures
+void computeSkelTemporalFeatures(const FrameSkel &frameNew,
+                                 const FrameSkel &frameOld,
+                                 vector<double> &features) {
+  features.clear();
+  for (int i = 0; i < frameNew.num_transformed_joints; i++) {
+    const pcl::PointXYZ &pNew = frameNew.transformed_joints[i];
+    const pcl::PointXYZ &pOld = frameOld.transformed_joints[i];
+    features.push_back(pNew.x - pOld.x);
+    features.push_back(pNew.y - pOld.y);
+    features.push_back(pNew.z - pOld.z);
+    features.push_back(pow((pNew.x - pOld.x), 2) + pow((pNew.y - pOld.y), 2)
+                       + pow((pNew.z - pOld.z), 2));
+  }
+  for (int i = 0; i < frameNew.num_local_joints; i++) {
+    const double *jNew = frameNew.joints_local[i];
+    const double *jOld = frameOld.joints_local[i];
+    features.push_back(jNew[pos_data_x] - jOld[pos_data_x]);
+    features.push_back(jNew[pos_data_y] - jOld[pos_data_y]);
+    features.push_back(jNew[pos_data_z] - jOld[pos_data_z]);
+    features.push_back(pow((jNew[pos_data_x] - jOld[pos_data_x]), 2)
+                       + pow((jNew[pos_data_y] - jOld[pos_data_y]), 2)
+                       + pow((jNew[pos_data_z] - jOld[pos_data_z]), 2));
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    cout << "Usage: " << argv[0] << " <data_directory> <activity_label_file>"
+         << endl;
+    return 1;
+  }
+  dataLocation = (string)argv[1] + "/";
+  string actfile = (string)argv[2];
+  readDataActMap(actfile);
+
+  double dataValues[JOINT_NUM][JOINT_DATA_NUM];
+  int dataConfValues[JOINT_NUM][JOINT_DATA_TYPE_NUM];
+  double posDataValues[POS_JOINT_NUM][POS_JOINT_DATA_NUM];
+  double *data[JOINT_NUM];
+  int *data_CONF[JOINT_NUM];
+  double *pos_data[POS_JOINT_NUM];
+  int pos_data_CONF[POS_JOINT_NUM];
+  for (int j = 0; j < JOINT_NUM; j++) {
+    data[j] = dataValues[j];
+    data_CONF[j] = dataConfValues[j];
+  }
+  for (int j = 0; j < POS_JOINT_NUM; j++) {
+    pos_data[j] = posDataValues[j];
+  }
+
+  std::ofstream sfeatfile("data_skel_feats.txt", ios::app);
+  std::ofstream temporalSkelfeatfile("data_temporal_skel_feats.txt", ios::app);
+  std::ofstream untrackedfile("data_skel_untracked.txt", ios::app);
+  SkeletonImputer imputer;
+  vector<FrameSkel> skeletons;
+  vector<int> frameNums;
+  vector<vector<double> > features;
+  vector<char> started;
+  vector<double> temporalFeatures;
+  FeaturesSkel featuresSkeleton(false);
+  int i = 0;
+  for (map<string, string>::iterator it = data_act_map.begin();
+       it != data_act_map.end(); it++, i++) {
+    const string &id = it->first;
+    printf("%d. ", i + 1);
+    string transformfile = dataLocation + id + "_globalTransform.txt";
+    TransformG globalTransform = readTranform(transformfile);
+
+    readData skeletonData(dataLocation, id, false);
+    skeletons.clear();
+    frameNums.clear();
+    int status = skeletonData.readNextFrame(data, pos_data, data_CONF,
+                                            pos_data_CONF);
+    imputer.startFrame(id);
+    while (status > 0) {
+      bool tracked = imputer.impute(data, pos_data, data_CONF, pos_data_CONF);
+      skeletons.push_back(FrameSkel());
+      skeletons.back().initialize(data, pos_data, globalTransform);
+      skeletons.back().setTracking(data_CONF, pos_data_CONF, tracked);
+      frameNums.push_back(status);
+      status = skeletonData.readNextFrame(data, pos_data, data_CONF,
+                                          pos_data_CONF);
+    }
+    if (skeletons.empty()) {
+      continue;
+    }
+
+    featuresSkeleton.computeSequenceFeatures(&skeletons[0], skeletons.size(),
+                                             features, started);
+    for (size_t t = 0; t < skeletons.size(); t++) {
+      if (!skeletons[t].tracked) {
+        features[t] = FeaturesSkel::getDefaultFeatureValues();
+        untrackedfile << id << "," << frameNums[t] << endl;
+      }
+      sfeatfile << id << "," << frameNums[t];
+      printFeats(features[t], sfeatfile);
+      if (t > 0) {
+        if (skeletons[t].tracked && skeletons[t-1].tracked) {
+          computeSkelTemporalFeatures(skeletons[t], skeletons[t-1],
+                                      temporalFeatures);
+        } else {
+          temporalFeatures.assign(4 * (skeletons[t].num_transformed_joints
+                                       + skeletons[t].num_local_joints), 0.0);
+        }
+        temporalSkelfeatfile << id << "," << frameNums[t-1] << ","
+                             << frameNums[t];
+        printFeats(temporalFeatures, temporalSkelfeatfile);
+      }
+    }
+  }
+  sfeatfile.close();
+  temporalSkelfeatfile.close();
+  untrackedfile.close();
+  imputer.print(cout);
+  printf("ALL DONE.\n\n");
+  return 0;
+}
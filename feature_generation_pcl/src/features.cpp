@@ -10,7 +10,14 @@ Copyright (C) 2012 Hema Koppula
 455~458: hand low high percentile
 459: head angle
 **/
-#include<algorithm>
+#include <assert.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <vector>
 
 bool DEBUG_numFeature = false; // turn on to print out how many features are being recorded
 
@@ -21,464 +28,549 @@ bool FOOT_AGAINST_HEAD = false; // keep it false; FOOT against Torso is being do
 bool USE_HAND_MOTION = false; // default: false.. not sure why it doesn't help..
 bool USE_BIGGEST_UPDOWN_HAND_MOVE = false; // default: false
 
+/*
+Loads, stores and square roots of one double, or of two packed ones (SSE2),
+for the skeleton kernels below. The kernels use the plain arithmetic
+operators, which GCC defines on the vector type too, so both versions do the
+same operations in the same order and give the same bits.
+ */
+template <typename V> struct SkeletonLanes;
+
+template <> struct SkeletonLanes<double> {
+  static const int size = 1;
+  static double load(const double *p) { return *p; }
+  static void store(double *p, double v) { *p = v; }
+  static double set(double v) { return v; }
+  static double root(double v) { return sqrt(v); }
+  // zeroes all of q unless all of it is finite
+  static void keepFinite(double *q) {
+    for (int k = 0; k < 4; k++) {
+      if (isnan(q[k]) || isinf(q[k])) {
+        q[0] = q[1] = q[2] = q[3] = 0.0;
+        return;
+      }
+    }
+  }
+};
 
+#ifdef __SSE2__
+// __m128d itself loses its attributes as a template argument
+typedef double SkeletonPair __attribute__((vector_size(16)));
+
+template <> struct SkeletonLanes<SkeletonPair> {
+  static const int size = 2;
+  static SkeletonPair load(const double *p) { return _mm_loadu_pd(p); }
+  static void store(double *p, SkeletonPair v) { _mm_storeu_pd(p, v); }
+  static SkeletonPair set(double v) { return _mm_set1_pd(v); }
+  static SkeletonPair root(SkeletonPair v) { return _mm_sqrt_pd(v); }
+  // x - x is 0 exactly when x is finite
+  static void keepFinite(SkeletonPair *q) {
+    __m128d zero = _mm_setzero_pd();
+    __m128d finite = _mm_cmpeq_pd(_mm_sub_pd(q[0], q[0]), zero);
+    for (int k = 1; k < 4; k++) {
+      finite = _mm_and_pd(finite, _mm_cmpeq_pd(_mm_sub_pd(q[k], q[k]), zero));
+    }
+    for (int k = 0; k < 4; k++) {
+      q[k] = _mm_and_pd(q[k], finite);
+    }
+  }
+};
+#endif
 
 class FeaturesSkel {
  private:
-  double ***prevFrame;  // [frameStoreNum][JOINT_NUM][JOINT_DATA_NUM]
-  // [frameStoreNum][POS_JOINT_NUM][POS_JOINT_DATA_NUM];
-  double ***prevFrame_posOnly;
+  /*
+  One row of numFrames values per feature, in one array which is kept
+  between calls. Every value of a row is written by whoever adds it.
+   */
+  class FeatureRows {
+   public:
+    FeatureRows() : numFrames_(0), size_(0) {}
+    void clear(int numFrames) {
+      numFrames_ = numFrames;
+      size_ = 0;
+      values_.resize(maxFeatures() * numFrames);
+    }
+    int size() const { return size_; }
+    double *add() {
+      assert(size_ < maxFeatures());
+      return &values_[(size_++) * numFrames_];
+    }
+    // drops the last n rows
+    void drop(int n) { size_ -= n; }
+    const double *operator[](int f) const { return &values_[f * numFrames_]; }
+
+   private:
+    std::vector<double> values_;
+    int numFrames_;
+    int size_;
+  };
+
+  // the number of features with every option on
+  static int maxFeatures() {
+    int numPercentiles = sizeof(percentile)/sizeof(percentile[0]);
+    return compareFrameNum*JOINT_NUM*4 + 4*3 + compareFrameNum*2*3
+           + 4*3 + 2*(numPercentiles + 2) + 1;
+  }
 
-  int currentFramePointer;
-  bool frameComparable;
+  static const int NUM_CHANNELS =
+      JOINT_NUM*JOINT_DATA_NUM + POS_JOINT_NUM*POS_JOINT_DATA_NUM;
+
+  /*
+  The last frameStoreNum frames given to extractSkeletonFeature, as channels
+  of 2*frameStoreNum frames like soa. Frame i is stored at i % frameStoreNum
+  and again frameStoreNum later, so that the last frameStoreNum frames are
+  always next to each other and end at historyEnd().
+   */
+  std::vector<double> history;
+  // the frames given to computeSequenceFeatures
+  std::vector<double> sequence;
+  int numFramesSeen;
+  FeatureRows rows;
   bool mirrored;
   std::vector<double> featureValues;
-  char* curFileName;
   bool ready;
 
-  void init(bool mirrored) {
-    currentFramePointer = -1;
-    frameComparable = false;
-    ready = true;
-    this->mirrored = mirrored;
+  // the hand percentiles are taken over these frames before the current one
+  static const int HAND_WINDOW_START = -2;
+  // and over this many zeros, see paddedOrderStatistic
+  static const int HAND_WINDOW_PADDING = 30;
+  // frames computed together by computeSequenceFeatures
+  static const int SEQUENCE_BLOCK_FRAMES = 64;
+
+  /*
+  The frames the features are computed from, history or sequence, as one
+  array of soaFrames frames per value (SoA): value c of joint j of frame t
+  is joint(j, c)[t], value c of position joint j is position(j, c)[t].
+   */
+  const double *soa;
+  int soaFrames;
+
+  const double *joint(int j, int c) const {
+    return soa + (j*JOINT_DATA_NUM + c)*soaFrames;
+  }
 
-    //init prevFrame
-    prevFrame = new double**[frameStoreNum];
-    for (int i=0;i<frameStoreNum;i++) {
-      prevFrame[i] = new double*[JOINT_NUM];
-      for (int j=0;j<JOINT_NUM;j++) {
-        prevFrame[i][j] = new double[JOINT_DATA_NUM];
-      }
-    }
+  const double *position(int j, int c) const {
+    return soa + (JOINT_NUM*JOINT_DATA_NUM + j*POS_JOINT_DATA_NUM + c)*soaFrames;
+  }
 
-    // init prevFrame_posOnly
-    prevFrame_posOnly = new double**[frameStoreNum];
-    for (int i=0;i<frameStoreNum;i++) {
-      prevFrame_posOnly[i] = new double*[POS_JOINT_NUM];
-      for (int j=0;j<POS_JOINT_NUM;j++) {
-        prevFrame_posOnly[i][j] = new double[POS_JOINT_DATA_NUM];
+  template <typename F>
+  void gather(const F *frames, int numFrames) {
+    sequence.resize(NUM_CHANNELS * numFrames);
+    soa = &sequence[0];
+    soaFrames = numFrames;
+    double *dst = &sequence[0];
+    for (int j = 0; j < JOINT_NUM; j++) {
+      for (int c = 0; c < JOINT_DATA_NUM; c++) {
+        for (int t = 0; t < numFrames; t++) {
+          *(dst++) = frames[t].data[j][c];
+        }
       }
     }
-
-    } // end init
-
-    int findFrame(int diff) {
-    //return ((currentFramePointer + diff) % frameStoreNum);
-    int a = (currentFramePointer + diff);
-    if (a >= frameStoreNum)
-      return a - frameStoreNum;
-    else if (a < 0)
-      return a + frameStoreNum;
-    else
-      return a;
+    for (int j = 0; j < POS_JOINT_NUM; j++) {
+      for (int c = 0; c < POS_JOINT_DATA_NUM; c++) {
+        for (int t = 0; t < numFrames; t++) {
+          *(dst++) = frames[t].pos_data[j][c];
+        }
+      }
     }
-
-    double* computeLocalHandLoc(double head_ori[9], double head_pos[3], double hand_pos[3]) {
-    double handx = hand_pos[0] - head_pos[0];
-    double handy = hand_pos[1] - head_pos[1];
-    double handz = hand_pos[2] - head_pos[2];
-
-    double* rel_hand = new double[3];
-
-    rel_hand[0] = (head_ori[0]*handx + head_ori[3]*handy + head_ori[6]*handz) / 1000;
-    rel_hand[1] = (head_ori[1]*handx + head_ori[4]*handy + head_ori[7]*handz) / 1000;
-    rel_hand[2] = (head_ori[2]*handx + head_ori[5]*handy + head_ori[8]*handz) / 1000;
-    return rel_hand;
   }
 
-  int computeFootPosition(double **data, double **pos_data, int variableNum) {
-    // compute foot loc
-    double left_foot_pos[3];
-    double right_foot_pos[3];
-    double head_ori[9];
-    double head_pos[3];
-    double torso_ori[9];
-    double torso_pos[3];
+  // the frames before the current one that the hand percentiles go back to
+  static int oldestHandFrame() {
+    return compareFrameNum > 0 ? compareFrame[compareFrameNum-1] : 0;
+  }
 
-    for (int i = 0; i < 9; i++) {
-      head_ori[i] = data[HEAD_JOINT_NUM][i];
-    }
-    for (int i = 0; i < 3; i++) {
-      head_pos[i] = data[HEAD_JOINT_NUM][i+9];
-    }
-    for (int i = 0; i < 9; i++) {
-      torso_ori[i] = data[TORSO_JOINT_NUM][i];
-    }
-    for (int i = 0; i < 3; i++) {
-      torso_pos[i]=data[TORSO_JOINT_NUM][i+9];
+  /*
+  Rotation of orientation c relative to orientation p as a quaternion, for
+  SkeletonLanes<V>::size frames from t on: m = p^T c. p and c point to the
+  9 arrays of the orientation matrices, the quaternions go to q from o on.
+   */
+  template <typename V>
+  static void relativeRotation(const double *const *p, const double *const *c,
+                               int t, double *const *q, int o) {
+    typedef SkeletonLanes<V> L;
+    V m[3][3];
+    for (int k = 0; k < 3; k++) {
+      V c0 = L::load(c[0+k] + t);
+      V c1 = L::load(c[3+k] + t);
+      V c2 = L::load(c[6+k] + t);
+      for (int r = 0; r < 3; r++) {
+        m[r][k] = L::load(p[r] + t)*c0 + L::load(p[3+r] + t)*c1
+                  + L::load(p[6+r] + t)*c2;
+      }
     }
-    for (int i = 0; i < 3; i++) {
-      left_foot_pos[i] = pos_data[POS_LEFT_FOOT_NUM][i];
+    V quat[4];
+    quat[0] = L::set(1.0/2.0) * L::root(L::set(1) + m[0][0] - m[1][1] - m[2][2]);
+    V s = L::set(1.0) / (L::set(4.0)*quat[0]);
+    quat[1] = s * (m[0][1] + m[1][0]);
+    quat[2] = s * (m[0][2] + m[2][0]);
+    quat[3] = s * (m[2][1] - m[1][2]);
+    L::keepFinite(quat);
+    for (int k = 0; k < 4; k++) {
+      L::store(q[k] + o, quat[k]);
     }
-    for (int i = 0; i < 3; i++) {
-      right_foot_pos[i] = pos_data[POS_RIGHT_FOOT_NUM][i];
+  }
+
+  /*
+  Position of a point relative to a joint, in the joint's frame and in
+  metres, for SkeletonLanes<V>::size frames from t on. ori points to the 9
+  arrays of the orientation matrix, pos and point to 3 arrays each. The
+  positions go to local from o on.
+   */
+  template <typename V>
+  static void localPosition(const double *const *ori, const double *const *pos,
+                            const double *const *point, int t,
+                            double *const *local, int o) {
+    typedef SkeletonLanes<V> L;
+    V dx = L::load(point[0] + t) - L::load(pos[0] + t);
+    V dy = L::load(point[1] + t) - L::load(pos[1] + t);
+    V dz = L::load(point[2] + t) - L::load(pos[2] + t);
+    for (int r = 0; r < 3; r++) {
+      L::store(local[r] + o, (L::load(ori[r] + t)*dx + L::load(ori[3+r] + t)*dy
+                              + L::load(ori[6+r] + t)*dz) / L::set(1000));
     }
+  }
 
-    double* left_foot;
-    if (FOOT_AGAINST_HEAD) {
-      left_foot = computeLocalHandLoc(head_ori, head_pos, left_foot_pos);
-      for (int i=0;i<3;i++) {
-        featureValues.push_back(left_foot[i]);
-        variableNum++;
-      }
+  /*
+  Runs kernel over frames [begin, end), two at a time when SSE2 is on. The
+  result of frame t goes to t - begin of the rows of the kernel.
+   */
+  template <typename Kernel>
+  static void forFrames(int begin, int end, Kernel &kernel) {
+    int t = begin;
+#ifdef __SSE2__
+    for (; t + 2 <= end; t += 2) {
+      kernel.template run<SkeletonPair>(t, t - begin);
+    }
+#endif
+    for (; t < end; t++) {
+      kernel.template run<double>(t, t - begin);
     }
-    left_foot = computeLocalHandLoc(torso_ori, torso_pos, left_foot_pos);
-    for (int i=0;i<3;i++) {
-      featureValues.push_back(left_foot[i]);
-      variableNum++;
-    }
-    double* right_foot;
-    if (FOOT_AGAINST_HEAD) {
-      right_foot = computeLocalHandLoc(head_ori, head_pos, right_foot_pos);
-      for (int i=0;i<3;i++) {
-        featureValues.push_back(right_foot[i]);
-        variableNum++;
+  }
+
+  struct RotationKernel {
+    const double *p[9];
+    const double *c[9];
+    double *q[4];
+    template <typename V> void run(int t, int o) {
+      relativeRotation<V>(p, c, t, q, o);
+    }
+  };
+
+  struct PositionKernel {
+    const double *ori[9];
+    const double *pos[3];
+    const double *point[3];
+    double *local[3];
+    template <typename V> void run(int t, int o) {
+      localPosition<V>(ori, pos, point, t, local, o);
+    }
+  };
+
+  /*
+  The quaternions of joint j of frame t relative to frame t + offset, or to
+  the torso of frame t if offset is 0. Frames with a NaN or infinite
+  component get a zero quaternion.
+   */
+  void addRotationFeatures(int j, int offset, int begin, int end,
+                           FeatureRows &rows) {
+    RotationKernel kernel;
+    for (int k = 0; k < 9; k++) {
+      if (offset == 0) {
+        kernel.p[k] = joint(TORSO_JOINT_NUM, k);
+      } else {
+        kernel.p[k] = joint(j, k) + offset;
       }
+      kernel.c[k] = joint(j, k);
     }
-    right_foot = computeLocalHandLoc(torso_ori, torso_pos, right_foot_pos);
-    for (int i=0;i<3;i++) {
-      featureValues.push_back(right_foot[i]);
-      variableNum++;
+    for (int k = 0; k < 4; k++) {
+      kernel.q[k] = rows.add();
     }
-    if (DEBUG_numFeature) printf("foot: %d\n", variableNum);
-    return variableNum;
-  } // end computeFootPosition
-
-
-  int computeHandPosition(double **data, double **pos_data, int variableNum) {
-
-    // compute hand loc
-    double left_hand_pos[3];
-    double right_hand_pos[3];
-    double head_ori[9];
-    double head_pos[3];
-    double torso_ori[9];
-    double torso_pos[3];
+    forFrames(begin, end, kernel);
+  }
 
-    for (int i = 0; i < 9; i++) {
-      head_ori[i]=data[HEAD_JOINT_NUM][i];
-    }
-    for (int i = 0; i < 3; i++) {
-      head_pos[i]=data[HEAD_JOINT_NUM][i+9];
-    }
-    for (int i = 0; i < 9; i++) {
-      torso_ori[i]=data[TORSO_JOINT_NUM][i];
-    }
-    for (int i = 0; i < 3; i++) {
-      torso_pos[i]=data[TORSO_JOINT_NUM][i+9];
+  // position joint point relative to joint j
+  void addLocalPositionFeatures(int j, int point, int begin, int end,
+                                FeatureRows &rows) {
+    PositionKernel kernel;
+    for (int k = 0; k < 9; k++) {
+      kernel.ori[k] = joint(j, k);
     }
-    for (int i = 0; i < 3; i++) {
-      left_hand_pos[i]=pos_data[POS_LEFT_HAND_NUM][i];
+    for (int k = 0; k < 3; k++) {
+      kernel.pos[k] = joint(j, 9+k);
+      kernel.point[k] = position(point, k);
+      kernel.local[k] = rows.add();
     }
-    for (int i = 0; i < 3; i++) {
-      right_hand_pos[i]=pos_data[POS_RIGHT_HAND_NUM][i];
-    }
-
+    forFrames(begin, end, kernel);
+  }
 
-    double* left_hand = computeLocalHandLoc(head_ori, head_pos, left_hand_pos);
-    for (int i = 0; i < 3; i++) {
-       // fprintf(pRecFile, "%.7f,",left_hand[i]);
-        featureValues.push_back(left_hand[i]);
-        variableNum++;
-    }
-    left_hand = computeLocalHandLoc(torso_ori, torso_pos, left_hand_pos);
-    for (int i = 0; i < 3; i++) {
-      //  fprintf(pRecFile, "%.7f,", left_hand[i]);
-        featureValues.push_back(left_hand[i]);
-        variableNum++;
+  // features 1 & 3 of AAAI paper
+  void addBodyPoseAndMotionFeatures(int begin, int end,
+                                    FeatureRows &rows) {
+    for (int i = 0; i < compareFrameNum; i++) {
+      for (int j = 0; j < JOINT_NUM; j++) {
+        if (compareFrame[i] == 0 && j == TORSO_JOINT_NUM) {
+          continue;
+        }
+        addRotationFeatures(j, compareFrame[i], begin, end, rows);
+      }
     }
+  }
 
-    double* right_hand = computeLocalHandLoc(head_ori, head_pos, right_hand_pos);
-    for (int i = 0; i < 3; i++) {
-        featureValues.push_back(right_hand[i]);
-        variableNum++;
-    }
-    right_hand = computeLocalHandLoc(torso_ori, torso_pos, right_hand_pos);
-    for (int i = 0; i < 3; i++) {
-      featureValues.push_back(right_hand[i]);
-      variableNum++;
+  // feature 2 of AAAI paper + some extra hand motion
+  void addHandFeatures(int begin, int end,
+                       FeatureRows &rows) {
+    addLocalPositionFeatures(HEAD_JOINT_NUM, POS_LEFT_HAND_NUM, begin, end, rows);
+    addLocalPositionFeatures(TORSO_JOINT_NUM, POS_LEFT_HAND_NUM, begin, end, rows);
+    addLocalPositionFeatures(HEAD_JOINT_NUM, POS_RIGHT_HAND_NUM, begin, end, rows);
+    addLocalPositionFeatures(TORSO_JOINT_NUM, POS_RIGHT_HAND_NUM, begin, end, rows);
+    if (!USE_HAND_MOTION) {
+      return;
     }
-    if (DEBUG_numFeature) printf("hand: %d\n", variableNum);
-
-    // Maybe try collecting hand motion.
-    if (USE_HAND_MOTION) {
-      double left_hand_pos_prev[3];
-      double right_hand_pos_prev[3];
-      double diff_left[3];
-      double diff_right[3];
-      for (int i = 0; i < compareFrameNum; i++) {
-        int frameCompareTo = findFrame(compareFrame[i]);
-        for (int j = 0; j < 3; j++) {
-          left_hand_pos_prev[j] = prevFrame_posOnly[frameCompareTo][POS_LEFT_HAND_NUM][j];
-          right_hand_pos_prev[j] = prevFrame_posOnly[frameCompareTo][POS_RIGHT_HAND_NUM][j];
-          diff_left[j] = left_hand_pos[j] - left_hand_pos_prev[j];
-          diff_right[j] = right_hand_pos[j] - right_hand_pos_prev[j];
-        }
-        for(int num = 0; num < 3; num++)
-        {
-          featureValues.push_back(diff_left[num]);
-        }
-        for(int num = 0; num < 3; num++)
-        {
-          featureValues.push_back(diff_right[num]);
+    for (int i = 0; i < compareFrameNum; i++) {
+      int hands[2] = {POS_LEFT_HAND_NUM, POS_RIGHT_HAND_NUM};
+      for (int h = 0; h < 2; h++) {
+        for (int k = 0; k < 3; k++) {
+          const double *now = position(hands[h], k);
+          const double *before = now + compareFrame[i];
+          double *diff = rows.add();
+          for (int t = begin; t < end; t++) {
+            diff[t - begin] = now[t] - before[t];
+          }
         }
-        variableNum += 6;
       }
-      if (DEBUG_numFeature) printf("hand motion: %d\n", variableNum);
     }
+  }
 
-    return variableNum;
-  } // end computeHandPosition
-
+  // foot location
+  void addFootFeatures(int begin, int end,
+                       FeatureRows &rows) {
+    int feet[2] = {POS_LEFT_FOOT_NUM, POS_RIGHT_FOOT_NUM};
+    for (int f = 0; f < 2; f++) {
+      if (FOOT_AGAINST_HEAD) {
+        addLocalPositionFeatures(HEAD_JOINT_NUM, feet[f], begin, end, rows);
+      }
+      addLocalPositionFeatures(TORSO_JOINT_NUM, feet[f], begin, end, rows);
+    }
+  }
 
-  int computeMoreHandFeatures(int variableNum) {
-    // compute hand loc
-    double left_hand_pos[3];
-    double right_hand_pos[3];
-    double head_ori[9];
-    double head_pos[3];
+  /*
+  The kth smallest of the values of sorted and HAND_WINDOW_PADDING zeros.
+  The hand percentiles have always been taken with these zeros, which fill
+  the front of the array the values were added to.
+   */
+  static double paddedOrderStatistic(const std::vector<double> &sorted, int k) {
+    int negatives = std::lower_bound(sorted.begin(), sorted.end(), 0.0)
+                    - sorted.begin();
+    if (k < negatives) {
+      return sorted[k];
+    }
+    if (k < negatives + HAND_WINDOW_PADDING) {
+      return 0.0;
+    }
+    return sorted[k - HAND_WINDOW_PADDING];
+  }
 
-    int latest = compareFrame[compareFrameNum-1];
-    vector<double> lhand(30);
-    vector<double> rhand(30);
-    int vCount=0;
-    for (int last = -2; last > latest; last--) {
-      int frameN = findFrame(last);
+  static void insertSorted(std::vector<double> &sorted, double v) {
+    sorted.insert(std::upper_bound(sorted.begin(), sorted.end(), v), v);
+  }
 
-      double ltemp = prevFrame_posOnly[frameN][POS_LEFT_HAND_NUM][1]
-                     - prevFrame[frameN][HEAD_JOINT_NUM][9+1]; // y value
-      double rtemp = prevFrame_posOnly[frameN][POS_RIGHT_HAND_NUM][1]
-                     - prevFrame[frameN][HEAD_JOINT_NUM][9+1]; // y value
-      lhand.push_back(ltemp);
-      rhand.push_back(rtemp);
-      vCount++;
+  static void eraseSorted(std::vector<double> &sorted, double v) {
+    std::vector<double>::iterator it =
+        std::lower_bound(sorted.begin(), sorted.end(), v);
+    if (it != sorted.end() && *it == v) {
+      sorted.erase(it);
     }
+  }
 
-    sort(lhand.begin(), lhand.end());
-    sort(rhand.begin(), rhand.end());
-
-    int numValue = vCount;
-
-    for (int i = 0; i < sizeof(percentile)/sizeof(percentile[0]); i++) {
-        int temp = numValue * percentile[i] / 100;
-        featureValues.push_back(lhand[temp]);
-        featureValues.push_back(rhand[temp]);
-        variableNum += 2;
-        if (DEBUG_numFeature)
-          printf("hand location (percentile: %d): %d\n",
-                 percentile[i], variableNum);
+  /*
+  Low and high percentiles of the height of each hand above the head over
+  the frames t-2 back to t+oldestHandFrame()+1. The windows of consecutive
+  frames differ by one frame at each end, so they are kept sorted and
+  updated rather than sorted for every frame.
+   */
+  void addHandPercentileFeatures(int begin, int end,
+                                 FeatureRows &rows) {
+    int first = oldestHandFrame() + 1;
+    int numValues = std::max(0, HAND_WINDOW_START - first + 1);
+    const double *headY = joint(HEAD_JOINT_NUM, 9+1);
+    const double *handY[2] = {position(POS_LEFT_HAND_NUM, 1),
+                              position(POS_RIGHT_HAND_NUM, 1)};
+
+    int numPercentiles = sizeof(percentile)/sizeof(percentile[0]);
+    std::vector<int> ranks;
+    for (int i = 0; i < numPercentiles; i++) {
+      ranks.push_back(numValues * percentile[i] / 100);
+    }
+    if (USE_BIGGEST_UPDOWN_HAND_MOVE) {
+      ranks.push_back(numValues * 5 / 100);
+      ranks.push_back(numValues * 95 / 100);
+    }
+    // values[rank][hand]
+    std::vector<double *> values;
+    for (size_t r = 0; r < ranks.size(); r++) {
+      values.push_back(rows.add());
+      values.push_back(rows.add());
+    }
+
+    for (int h = 0; h < 2; h++) {
+      std::vector<double> sorted;
+      for (int t = begin; t < end; t++) {
+        if (t == begin) {
+          for (int d = first; d <= HAND_WINDOW_START; d++) {
+            sorted.push_back(handY[h][t+d] - headY[t+d]);
+          }
+          std::sort(sorted.begin(), sorted.end());
+        } else if (numValues > 0) {
+          int in = t + HAND_WINDOW_START, out = t - 1 + first;
+          insertSorted(sorted, handY[h][in] - headY[in]);
+          eraseSorted(sorted, handY[h][out] - headY[out]);
+        }
+        for (size_t r = 0; r < ranks.size(); r++) {
+          values[2*r + h][t - begin] = paddedOrderStatistic(sorted, ranks[r]);
+        }
+      }
     }
 
+    // the percentiles then the biggest move, each as left, right
     if (USE_BIGGEST_UPDOWN_HAND_MOVE) {
-      int temp1 = numValue * 5 / 100;
-      int temp2 = numValue * 95 / 100;
-      double moveL = lhand[temp2]-lhand[temp1];
-      double moveR = rhand[temp2]-rhand[temp1];
-      featureValues.push_back(moveL);
-      featureValues.push_back(moveR);
-      variableNum += 2;
-      if (DEBUG_numFeature)
-        printf("hand biggest move (up/down): %d\n", variableNum);
-    }
-
-    if (DEBUG_numFeature)
-      printf("extra hand features (percentile+move): %d\n", variableNum);
-    return variableNum;
-  } // end computeMoreHandFeatures
-
-  int computeHead(int variableNum) {
-    int curFrame = findFrame(0);
-    // compute hand loc
-    double heap_pos[3];
-    double head_pos[3];
-    double head_up[3];
-
-    double he_fs = 0; // head from sensor
-    double hp_fs = 0; // heap from sensor
-
-    for (int i = 0; i < 3; i++) {
-        double ltemp = prevFrame[curFrame][7][i+9];
-        double rtemp = prevFrame[curFrame][9][i+9];
+      for (int h = 0; h < 2; h++) {
+        double *low = values[2*numPercentiles + h];
+        double *high = values[2*(numPercentiles+1) + h];
+        for (int o = 0; o < end - begin; o++) {
+          low[o] = high[o] - low[o];
+        }
+      }
+      // the high rows now hold nothing
+      rows.drop(2);
+    }
+  }
+
+  // angle of the head against the middle of the hips
+  void addHeadFeature(int begin, int end,
+                      FeatureRows &rows) {
+    double *angle = rows.add();
+    for (int t = begin; t < end; t++) {
+      double heap_pos[3];
+      double head_pos[3];
+      double head_up[3];
+
+      double he_fs = 0; // head from sensor
+      double hp_fs = 0; // heap from sensor
+
+      for (int i = 0; i < 3; i++) {
+        double ltemp = joint(7, i+9)[t];
+        double rtemp = joint(9, i+9)[t];
         heap_pos[i] = (ltemp+rtemp)/2;
 
-        head_pos[i] = prevFrame[curFrame][HEAD_JOINT_NUM][i+9];
+        head_pos[i] = joint(HEAD_JOINT_NUM, i+9)[t];
 
         head_up[i] = heap_pos[i];
         if (i==1) { // y val
-            head_up[i] = head_pos[i];
+          head_up[i] = head_pos[i];
         }
 
         if (i != 1) { // except y val
-            he_fs += (head_pos[i]*head_pos[i]);
-            hp_fs += (heap_pos[i]*heap_pos[i]);
+          he_fs += (head_pos[i]*head_pos[i]);
+          hp_fs += (heap_pos[i]*heap_pos[i]);
         }
-    }
+      }
 
-    double v1[3]; // heap to head
-    double v2[3]; // heap to up
-    double v1_det = 0;
-    double v2_det = 0;
-    double dot = 0;
+      double v1[3]; // heap to head
+      double v2[3]; // heap to up
+      double v1_det = 0;
+      double v2_det = 0;
+      double dot = 0;
 
-    for (int i = 0; i < 3; i++) {
+      for (int i = 0; i < 3; i++) {
         v1[i] = head_pos[i] - heap_pos[i];
         v2[i] = head_up[i] - heap_pos[i];
 
         dot += (v1[i]*v2[i]);
         v1_det += (v1[i]*v1[i]);
         v2_det += (v2[i]*v2[i]);
-    }
-    v1_det = sqrt(v1_det);
-    v2_det = sqrt(v2_det);
+      }
+      v1_det = sqrt(v1_det);
+      v2_det = sqrt(v2_det);
 
-    double ang = acos(dot / (v1_det * v2_det));
+      double ang = acos(dot / (v1_det * v2_det));
 
-    ang = ang * 180 / 3.14159265; // to degree
+      ang = ang * 180 / 3.14159265; // to degree
 
-    if (he_fs > hp_fs) { // if heap is closer
+      if (he_fs > hp_fs) { // if heap is closer
         ang = -ang;
+      }
+      angle[t - begin] = ang;
     }
+  }
 
-    featureValues.push_back(ang);
-    variableNum++;
-
-    if (DEBUG_numFeature) printf("HEAD angle feature: %d\n", variableNum);
-    return variableNum;
-  } // end computeHead
-
-  int computeBodyPoseAndMotionInfo(double **data, double **pos_data, int variableNum) {
-    for (int i = 0; i < compareFrameNum; i++) {
-      for (int j = 0; j < JOINT_NUM; j++) {
-
-          int frameCompareTo = findFrame(compareFrame[i]);
-
-          if (currentFramePointer == frameCompareTo) {
-              if (j != TORSO_JOINT_NUM) {
-                  // rot mat
-                  double m[3][3];
-
-                  for (int k = 0; k < 3; k++) {
-                      m[0][k]=  prevFrame[currentFramePointer][TORSO_JOINT_NUM][0]*prevFrame[currentFramePointer][j][0+k]
-                              + prevFrame[currentFramePointer][TORSO_JOINT_NUM][3]*prevFrame[currentFramePointer][j][3+k]
-                              + prevFrame[currentFramePointer][TORSO_JOINT_NUM][6]*prevFrame[currentFramePointer][j][6+k];
-                      m[1][k]=  prevFrame[currentFramePointer][TORSO_JOINT_NUM][1]*prevFrame[currentFramePointer][j][0+k]
-                              + prevFrame[currentFramePointer][TORSO_JOINT_NUM][4]*prevFrame[currentFramePointer][j][3+k]
-                              + prevFrame[currentFramePointer][TORSO_JOINT_NUM][7]*prevFrame[currentFramePointer][j][6+k];
-                      m[2][k]=  prevFrame[currentFramePointer][TORSO_JOINT_NUM][2]*prevFrame[currentFramePointer][j][0+k]
-                              + prevFrame[currentFramePointer][TORSO_JOINT_NUM][5]*prevFrame[currentFramePointer][j][3+k]
-                              + prevFrame[currentFramePointer][TORSO_JOINT_NUM][8]*prevFrame[currentFramePointer][j][6+k];
-
-                  }
-                  // quat
-                  double q1 = 1.0/2.0 * sqrt(1 + m[0][0] - m[1][1] - m[2][2]);
-                  double q2 = 1.0/(4.0*q1) * (m[0][1] + m[1][0]);
-                  double q3 = 1.0/(4.0*q1) * (m[0][2] + m[2][0]);
-                  double q4 = 1.0/(4.0*q1) * (m[2][1] - m[1][2]);
-
-                  if (!isnan(q1) && !isnan(q2) && !isnan(q3) && !isnan(q4)
-                          && !isinf(q1) && !isinf(q2) && !isinf(q3) && !isinf(q4)) {
-                      featureValues.push_back(q1);
-                      featureValues.push_back(q2);
-                      featureValues.push_back(q3);
-                      featureValues.push_back(q4);
-                  } else {
-                      double zero = 0.0;
-                      for(int num =0; num<4; num++)
-                          featureValues.push_back(zero);
-                  }
-                  variableNum += 4;
-                  if(DEBUG_numFeature) printf("current frame : %d\n", variableNum);
-              }
-          } else {
-            // rot mat
-            double m[3][3];
-            for (int k = 0; k < 3; k++) {
-              m[0][k]=  prevFrame[frameCompareTo][j][0]*prevFrame[currentFramePointer][j][0+k]
-                      + prevFrame[frameCompareTo][j][3]*prevFrame[currentFramePointer][j][3+k]
-                      + prevFrame[frameCompareTo][j][6]*prevFrame[currentFramePointer][j][6+k];
-              m[1][k]=  prevFrame[frameCompareTo][j][1]*prevFrame[currentFramePointer][j][0+k]
-                      + prevFrame[frameCompareTo][j][4]*prevFrame[currentFramePointer][j][3+k]
-                      + prevFrame[frameCompareTo][j][7]*prevFrame[currentFramePointer][j][6+k];
-              m[2][k]=  prevFrame[frameCompareTo][j][2]*prevFrame[currentFramePointer][j][0+k]
-                      + prevFrame[frameCompareTo][j][5]*prevFrame[currentFramePointer][j][3+k]
-                      + prevFrame[frameCompareTo][j][8]*prevFrame[currentFramePointer][j][6+k];
-            }
-            // quat
-            double q1 = 1.0/2.0 * sqrt(1 + m[0][0] - m[1][1] - m[2][2]);
-            double q2 = 1.0/(4.0*q1) * (m[0][1] + m[1][0]);
-            double q3 = 1.0/(4.0*q1) * (m[0][2] + m[2][0]);
-            double q4 = 1.0/(4.0*q1) * (m[2][1] - m[1][2]);
-
-            if (!isnan(q1) && !isnan(q2) && !isnan(q3) && !isnan(q4)
-                &&!isinf(q1) && !isinf(q2) && !isinf(q3) && !isinf(q4)) {
-              featureValues.push_back(q1);
-              featureValues.push_back(q2);
-              featureValues.push_back(q3);
-              featureValues.push_back(q4);
-            } else {
-              double zero = 0.0;
-              for(int num = 0; num < 4; num++)
-                featureValues.push_back(zero);
-            }
-            variableNum+=4;
-            if(DEBUG_numFeature)
-              printf("comparing against frame : %d (against:%d)\n",
-                     variableNum, compareFrame[i]);
-        }
-
-      } // end j
-    } // end i
+  /*
+  The features of frames [begin, end) of the gathered sequence, one row per
+  feature in the order of the layout at the top of this file. Value t - begin
+  of a row belongs to frame t.
+   */
+  void computeRows(int begin, int end, FeatureRows &rows) {
+    rows.clear(end - begin);
+    addBodyPoseAndMotionFeatures(begin, end, rows);
+    if (DEBUG_numFeature) printf("body pose and motion: %d\n", rows.size());
+    addHandFeatures(begin, end, rows);
+    if (DEBUG_numFeature) printf("hand: %d\n", rows.size());
+    addFootFeatures(begin, end, rows);
+    if (DEBUG_numFeature) printf("foot: %d\n", rows.size());
+    addHandPercentileFeatures(begin, end, rows);
+    if (DEBUG_numFeature) printf("hand percentiles: %d\n", rows.size());
+    if (HEAD_AGAINST_MID_HEAP) {
+      addHeadFeature(begin, end, rows);
+    }
+    if (DEBUG_numFeature) printf("\t\tfeatures: %d\n", rows.size());
+  }
 
-    return variableNum;
-  } // end computeBodyPoseAndMotionInfo
+  int historyEnd() const {
+    return (numFramesSeen - 1) % frameStoreNum + frameStoreNum + 1;
+  }
 
-  bool processData(double **data, double **pos_data) {
-    featureValues.clear();
-    // advance one frame
-    currentFramePointer=findFrame(1);
+  void init(bool mirrored) {
+    history.assign(NUM_CHANNELS * 2*frameStoreNum, 0.0);
+    numFramesSeen = 0;
+    ready = true;
+    this->mirrored = mirrored;
+  }
 
-    // store current data
-    for (int i = 0; i<JOINT_NUM; i++) {
-      for (int j = 0; j<JOINT_DATA_NUM; j++) {
-        prevFrame[currentFramePointer][i][j] = data[i][j];
+  // keeps the frame in history, false until frameStoreNum frames were seen
+  bool storeFrame(double **data, double **pos_data) {
+    double *dst = &history[numFramesSeen % frameStoreNum];
+    int channel = 0;
+    for (int i = 0; i < JOINT_NUM; i++) {
+      for (int j = 0; j < JOINT_DATA_NUM; j++, channel++) {
+        dst[channel*2*frameStoreNum] = data[i][j];
+        dst[channel*2*frameStoreNum + frameStoreNum] = data[i][j];
       }
     }
-
-    for (int i = 0; i<POS_JOINT_NUM; i++) {
-      for (int j = 0; j<POS_JOINT_DATA_NUM; j++) {
-        prevFrame_posOnly[currentFramePointer][i][j] = pos_data[i][j];
+    for (int i = 0; i < POS_JOINT_NUM; i++) {
+      for (int j = 0; j < POS_JOINT_DATA_NUM; j++, channel++) {
+        dst[channel*2*frameStoreNum] = pos_data[i][j];
+        dst[channel*2*frameStoreNum + frameStoreNum] = pos_data[i][j];
       }
     }
+    numFramesSeen++;
+    return numFramesSeen >= frameStoreNum;
+  }
 
-    // compute diff
-    if (currentFramePointer >= (frameStoreNum-1)) {
-      frameComparable = true;
-    }
-    if (!frameComparable) {
-      cout << "current frame pointer " << currentFramePointer << endl;
-      if (currentFramePointer >= (frameStoreNum-1)) {
-        frameComparable = true;
-      }
-    } else {
-      int variableNum = 0;
-      // feature 1 & 3 of AAAI paper
-      variableNum = computeBodyPoseAndMotionInfo(data,pos_data,variableNum);
-      // feature 2 of AAAI paper + some extra Hand motion (hand motion fails)
-      variableNum = computeHandPosition(data,pos_data,variableNum);
-      // foot location
-      variableNum = computeFootPosition(data,pos_data,variableNum);
-      // hand percentile
-      variableNum = computeMoreHandFeatures(variableNum);
-
-      if (HEAD_AGAINST_MID_HEAP) {
-        variableNum = computeHead(variableNum);
-      }
-      if(DEBUG_numFeature) {
-        printf("\t\tfeatures: %d\n", variableNum);
-      }
-      return true;
-    }
-    return false;
+  bool processData(double **data, double **pos_data) {
+    featureValues.clear();
+    if (!storeFrame(data, pos_data)) {
+      cout << "current frame pointer " << numFramesSeen - 1 << endl;
+      return false;
+    }
+    soa = &history[0];
+    soaFrames = 2*frameStoreNum;
+    computeRows(historyEnd() - 1, historyEnd(), rows);
+    featureValues.resize(rows.size());
+    for (int f = 0; f < rows.size(); f++) {
+      featureValues[f] = rows[f][0];
+    }
+    return true;
   }
 
  public:
@@ -486,24 +578,35 @@ class FeaturesSkel {
     return featureValues;
   }
 
-  bool addData(double **data, double **pos_data) {
-    // advance one frame
-    currentFramePointer=findFrame(1);
-    // store current data
-    for (int i = 0; i < JOINT_NUM; i++) {
-      for (int j = 0; j < JOINT_DATA_NUM; j++) {
-        prevFrame[currentFramePointer][i][j] = data[i][j];
-      }
+  // the number of features of a frame with the current options
+  static int numFeatures() {
+    int numPercentiles = sizeof(percentile)/sizeof(percentile[0]);
+    int count = 0;
+    for (int i = 0; i < compareFrameNum; i++) {
+      count += (compareFrame[i] == 0) ? (JOINT_NUM - 1)*4 : JOINT_NUM*4;
     }
-
-    for (int i = 0; i < POS_JOINT_NUM; i++) {
-      for (int j = 0;j < POS_JOINT_DATA_NUM; j++) {
-        prevFrame_posOnly[currentFramePointer][i][j] = pos_data[i][j];
-      }
+    count += 4*3;
+    if (USE_HAND_MOTION) {
+      count += compareFrameNum*2*3;
+    }
+    count += (FOOT_AGAINST_HEAD ? 4 : 2)*3;
+    count += 2*numPercentiles;
+    if (USE_BIGGEST_UPDOWN_HAND_MOVE) {
+      count += 2;
     }
-    if (currentFramePointer >= (frameStoreNum-1)) {
-      frameComparable = true;
+    if (HEAD_AGAINST_MID_HEAP) {
+      count += 1;
     }
+    return count;
+  }
+
+  // the features of a frame without a valid skeleton
+  static std::vector<double> getDefaultFeatureValues() {
+    return std::vector<double>(numFeatures(), 0.0);
+  }
+
+  bool addData(double **data, double **pos_data) {
+    return storeFrame(data, pos_data);
   }
 
   // return true if feature extraction started and successful..
@@ -517,19 +620,53 @@ class FeaturesSkel {
     return false;
   }
 
+  /*
+  The features of a whole sequence at once, the same as extractSkeletonFeature
+  gives for each of its frames in turn from a fresh FeaturesSkel: started[t]
+  tells whether frame t has features, which are then features[t]. F is any
+  type with data and pos_data arrays, e.g. FrameSkel.
+   */
+  template <typename F>
+  void computeSequenceFeatures(const F *frames, int numFrames,
+                               std::vector<std::vector<double> > &features,
+                               std::vector<char> &started) {
+    features.assign(numFrames, std::vector<double>());
+    started.assign(numFrames, 0);
+    int begin = frameStoreNum - 1;
+    if (numFrames <= begin) {
+      return;
+    }
+    gather(frames, numFrames);
+    // a block of frames at a time, so that its rows stay in cache
+    std::vector<const double *> row;
+    for (; begin < numFrames; begin += SEQUENCE_BLOCK_FRAMES) {
+      int end = std::min(numFrames, begin + SEQUENCE_BLOCK_FRAMES);
+      computeRows(begin, end, rows);
+      int numFeatures = rows.size();
+      row.resize(numFeatures);
+      for (int f = 0; f < numFeatures; f++) {
+        row[f] = rows[f];
+      }
+      for (int t = begin; t < end; t++) {
+        started[t] = 1;
+        features[t].resize(numFeatures);
+        double *values = &features[t][0];
+        for (int f = 0; f < numFeatures; f++) {
+          values[f] = row[f][t - begin];
+        }
+      }
+    }
+  }
+
   bool reset(bool mirrored){
-    delete prevFrame;
     init(mirrored);
+    return true;
   }
 
-  FeaturesSkel() : ready(false) {}
+  FeaturesSkel() : numFramesSeen(0), mirrored(false), ready(false),
+                   soa(NULL), soaFrames(0) {}
 
-  FeaturesSkel(bool mirrored) {
+  FeaturesSkel(bool mirrored) : soa(NULL), soaFrames(0) {
     init(mirrored);
   }
-
-  ~FeaturesSkel() {
-    delete prevFrame;
-  }
-
 };
@@ -167,30 +167,18 @@ class FeaturesSkelRGBD{
     double stripeSize = ((double)(maxYBlock - minYBlock)) / numStripes;
 
     for (int n = 0; n < numStripes; n++) {
-      // For each stripe, create a new HOGFeaturesOfBlock vector hogvec and fill it with the HOGFeaturesOfBlocks
-      // in this stripe.
-      std::vector<HOGFeaturesOfBlock> hogvec;
-      for (int j = (int)(minYBlock + n * stripeSize); j <= (int)(minYBlock + (n+1) * stripeSize); j++){
-        for (int i = minXBlock; i <= maxXBlock; i++){
-          HOGFeaturesOfBlock hfob;
-          hog.getFeatVec(j, i, hfob);
-          hogvec.push_back(hfob);
-        }
-      }
-      // Now compute the aggregate features for this stripe, and store the aggregate as its own
+      // Compute the aggregate features for this stripe, and store the aggregate as its own
       // HOGFeaturesOfBlock in the aggHogVec vector.
       HOGFeaturesOfBlock agg_hfob;
-      HOGFeaturesOfBlock::aggregateFeatsOfBlocks(hogvec, agg_hfob);
+      hog.getMeanFeatVec((int)(minYBlock + n * stripeSize), (int)(minYBlock + (n+1) * stripeSize),
+                         minXBlock, maxXBlock, agg_hfob);
       aggHogVec.push_back(agg_hfob);
     }
   }
 
-  /* This function take a bunch of data and an enum specifying the body part, and computes the HOG features
-  for the bounding box surrounding that body part. The result is pushed into aggHogVec. */
-  void computeBodyPartHOGFeatures(int ***IMAGE, HOG & hog, double **data, double **pos_data, enum BodyPart bodyPart,
-                                  std::vector<HOGFeaturesOfBlock> & aggHogVec) {
+  /* The HOG blocks of the bounding box surrounding a body part. */
+  BlockRect getBodyPartBlocks(int ***IMAGE, double **data, double **pos_data, enum BodyPart bodyPart) {
     Point2D corners [2];
-    const int numStripes = 1;
     if (bodyPart == HEAD) findHeadBoundingBox(IMAGE, data, pos_data, corners);
     else if (bodyPart == TORSO) findTorsoBoundingBox(IMAGE, data, pos_data, corners);
     else if (bodyPart == LEFTARM) findLeftArmBoundingBox(IMAGE, data, pos_data, corners);
@@ -200,12 +188,17 @@ class FeaturesSkelRGBD{
     else if (bodyPart == FULLBODY) findFullBodyBoundingBox(IMAGE, data, pos_data, corners);
     else assert(false);
 
-    int minXBlock = (int)(corners[0].x / BLOCK_SIDE);
-    int minYBlock = (int)(corners[0].y / BLOCK_SIDE);
-    int maxXBlock = (int)(corners[1].x / BLOCK_SIDE);
-    int maxYBlock = (int)(corners[1].y / BLOCK_SIDE);
+    return BlockRect(corners[0].x / BLOCK_SIDE, corners[0].y / BLOCK_SIDE,
+                     corners[1].x / BLOCK_SIDE, corners[1].y / BLOCK_SIDE);
+  }
 
-    computeAggHogBlock(hog, numStripes, minXBlock, maxXBlock, minYBlock, maxYBlock, aggHogVec);
+  /* This function take a bunch of data and an enum specifying the body part, and computes the HOG features
+  for the bounding box surrounding that body part. The result is pushed into aggHogVec. */
+  void computeBodyPartHOGFeatures(int ***IMAGE, HOG & hog, double **data, double **pos_data, enum BodyPart bodyPart,
+                                  std::vector<HOGFeaturesOfBlock> & aggHogVec) {
+    const int numStripes = 1;
+    BlockRect blocks = getBodyPartBlocks(IMAGE, data, pos_data, bodyPart);
+    computeAggHogBlock(hog, numStripes, blocks.minX, blocks.maxX, blocks.minY, blocks.maxY, aggHogVec);
   }
 
   /* Take all the features in the vector aggHogVec, and compile them into a single double array. */
@@ -286,19 +279,24 @@ class FeaturesSkelRGBD{
   Computes both image HOG featurs and depth HOG features.
   Return a pointer to a double array with those features, and popualte the numFeats
   integer with the length of the returned doubled array. Note that the first half
-  of the returned array is image features, while the second half is depth features. */
+  of the returned array is image features, while the second half is depth features.
+  If imageHog is given, the body parts are added to it and the image features are
+  read from it rather than from a HOG of IMAGE, unless the skeleton is mirrored. */
   vector<double> computeFeatures(int ***IMAGE, double **data, double **pos_data, int numFeats,
                                  bool useHead, bool useTorso, bool useLeftArm,
                                  bool useRightArm, bool useLeftHand, bool useRightHand,
-                                 bool useFullBody, bool useImage, bool useDepth) {
+                                 bool useFullBody, bool useImage, bool useDepth,
+                                 HOGContext *imageHog = NULL) {
 
-    int ***depthIMAGE;
     if (useDepth){
-      depthIMAGE = new int**[width];
-      for (int i = 0; i < width; i++){
-        depthIMAGE[i] = new int*[height];
-        for (int j = 0; j < height; j++){
-          depthIMAGE[i][j] = new int[4];
+      // allocated once, then reused for every frame
+      if (depthIMAGE == NULL){
+        depthIMAGE = new int**[width];
+        for (int i = 0; i < width; i++){
+          depthIMAGE[i] = new int*[height];
+          for (int j = 0; j < height; j++){
+            depthIMAGE[i][j] = new int[4];
+          }
         }
       }
 
@@ -307,68 +305,52 @@ class FeaturesSkelRGBD{
 
     if (this->mirrored) mirrorData(IMAGE, width, height);
 
-    HOG hog, depthHog;
-
-    if (useImage)
-      hog.computeHOG(IMAGE, width, height);
+    std::vector<BodyPart> parts;
+    if (useHead) parts.push_back(HEAD);
+    if (useTorso) parts.push_back(TORSO);
+    if (useLeftArm) parts.push_back(LEFTARM);
+    if (useRightArm) parts.push_back(RIGHTARM);
+    if (useLeftHand) parts.push_back(LEFTHAND);
+    if (useRightHand) parts.push_back(RIGHTHAND);
+    if (useFullBody) parts.push_back(FULLBODY);
+    // the depth features of the right hand are taken from the left hand box
+    std::vector<BodyPart> depthParts(parts);
+    for (size_t i = 0; i < depthParts.size(); i++) {
+      if (depthParts[i] == RIGHTHAND) depthParts[i] = LEFTHAND;
+    }
 
-    if (useDepth)
-      depthHog.computeHOG(depthIMAGE, width, height);
+    // HOG is only computed around the body parts
+    HOG *partHog = &hog;
+    std::vector<BlockRect> rects;
 
-    std::vector<HOGFeaturesOfBlock> aggHogVec;
     if (useImage){
-      if (useHead)
-        computeBodyPartHOGFeatures(IMAGE, hog, data, pos_data, HEAD, aggHogVec);
-
-      if (useTorso)
-        computeBodyPartHOGFeatures(IMAGE, hog, data, pos_data, TORSO, aggHogVec);
-
-      if (useLeftArm)
-        computeBodyPartHOGFeatures(IMAGE, hog, data, pos_data, LEFTARM, aggHogVec);
-
-      if (useRightArm)
-        computeBodyPartHOGFeatures(IMAGE, hog, data, pos_data, RIGHTARM, aggHogVec);
-
-      if (useLeftHand)
-        computeBodyPartHOGFeatures(IMAGE, hog, data, pos_data, LEFTHAND, aggHogVec);
-
-      if (useRightHand)
-        computeBodyPartHOGFeatures(IMAGE, hog, data, pos_data, RIGHTHAND, aggHogVec);
-
-      if (useFullBody)
-        computeBodyPartHOGFeatures(IMAGE, hog, data, pos_data, FULLBODY, aggHogVec);
+      for (size_t i = 0; i < parts.size(); i++)
+        rects.push_back(getBodyPartBlocks(IMAGE, data, pos_data, parts[i]));
+      if (imageHog != NULL && !this->mirrored){
+        for (size_t i = 0; i < rects.size(); i++)
+          imageHog->addBlocks(rects[i]);
+        partHog = &imageHog->get();
+      } else {
+        hog.computeHOG(IMAGE, width, height, rects);
+      }
     }
 
     if (useDepth){
-      if (useHead)
-        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, HEAD, aggHogVec);
-
-      if (useTorso)
-        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, TORSO, aggHogVec);
-
-      if (useLeftArm)
-        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, LEFTARM, aggHogVec);
-
-      if (useRightArm)
-        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, RIGHTARM, aggHogVec);
-
-      if (useLeftHand)
-        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, LEFTHAND, aggHogVec);
-
-      if (useRightHand)
-        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, LEFTHAND, aggHogVec);
+      rects.clear();
+      for (size_t i = 0; i < depthParts.size(); i++)
+        rects.push_back(getBodyPartBlocks(depthIMAGE, data, pos_data, depthParts[i]));
+      depthHog.computeHOG(depthIMAGE, width, height, rects);
+    }
 
-      if (useFullBody)
-        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, FULLBODY, aggHogVec);
+    std::vector<HOGFeaturesOfBlock> aggHogVec;
+    if (useImage){
+      for (size_t i = 0; i < parts.size(); i++)
+        computeBodyPartHOGFeatures(IMAGE, *partHog, data, pos_data, parts[i], aggHogVec);
+    }
 
-      // Tear down
-      for (int i = 0; i < width; i++){
-        for (int j = 0; j < height; j++){
-          delete [] depthIMAGE[i][j];
-        }
-        delete [] depthIMAGE[i];
-      }
-      delete [] depthIMAGE;
+    if (useDepth){
+      for (size_t i = 0; i < depthParts.size(); i++)
+        computeBodyPartHOGFeatures(depthIMAGE, depthHog, data, pos_data, depthParts[i], aggHogVec);
     }
 
     return aggregateFeaturesIntoVector(aggHogVec, numFeats);
@@ -379,13 +361,33 @@ class FeaturesSkelRGBD{
   FeaturesSkelRGBD(FILE* pRecFile, bool mirrored) {
     this->pRecFile=pRecFile;
     this->mirrored=mirrored;
+    this->depthIMAGE=NULL;
   }
   FeaturesSkelRGBD(bool mirrored) {
-    this->pRecFile=pRecFile;
+    this->pRecFile=NULL;
     this->mirrored=mirrored;
+    this->depthIMAGE=NULL;
+  }
+
+  ~FeaturesSkelRGBD() {
+    if (depthIMAGE == NULL) return;
+    for (int i = 0; i < width; i++){
+      for (int j = 0; j < height; j++){
+        delete [] depthIMAGE[i][j];
+      }
+      delete [] depthIMAGE[i];
+    }
+    delete [] depthIMAGE;
   }
 
-  ~FeaturesSkelRGBD() {}
+ private:
+  // the HOGs and the depth image are kept between frames
+  HOG hog, depthHog;
+  int ***depthIMAGE;
+
+  // owns depthIMAGE
+  FeaturesSkelRGBD(const FeaturesSkelRGBD &);
+  FeaturesSkelRGBD &operator=(const FeaturesSkelRGBD &);
 
 
 };
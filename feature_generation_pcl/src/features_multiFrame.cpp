@@ -15,8 +15,9 @@ class Segment {
   FeaturesSkel* features_skeleton;
   int segmentId;
 
+  // takes over the frames of f
   Segment(vector<Frame> &f, int id) {
-    frames = f;
+    frames.swap(f);
     segmentId = id;
     bool mirrored = false;
     features_skeleton = new FeaturesSkel(mirrored);
@@ -28,8 +29,10 @@ class Segment {
     features_skeleton = new FeaturesSkel(mirrored);
   }
 
+  // takes over the frames of f, which is left empty
   void reset(vector<Frame> &f, int id) {
-    frames = f;
+    frames.swap(f);
+    f.clear();
     segmentId = id;
     obj_features.clear();
     obj_obj_features.clear();
@@ -50,10 +53,10 @@ class Segment {
   vector<double> computeSkelObjFeatures(const FrameSkel & skel, const ObjectProfile & obj) {
     vector<double> features;
     double dist = 0;
-    for (size_t i = 0; i < skel.transformed_joints.size(); i++) {
-      dist = pow((skel.transformed_joints.at(i).x - obj.centroid.x), 2);
-      dist += pow((skel.transformed_joints.at(i).y - obj.centroid.y), 2);
-      dist += pow((skel.transformed_joints.at(i).z - obj.centroid.z), 2);
+    for (int i = 0; i < skel.num_transformed_joints; i++) {
+      dist = pow((skel.transformed_joints[i].x - obj.centroid.x), 2);
+      dist += pow((skel.transformed_joints[i].y - obj.centroid.y), 2);
+      dist += pow((skel.transformed_joints[i].z - obj.centroid.z), 2);
       features.push_back(dist);
     }
     return features;
@@ -83,6 +86,10 @@ class Segment {
   void computeFrameSkelObjPairFeatures(Frame &frame,vector<vector<double> >& features ) {
     // for every pair of objects compute the objObj features
     for (size_t i = 0; i < frame.objects.size(); i++) {
+      if (!frame.skeleton.tracked) {
+        features.push_back(vector<double>(frame.skeleton.num_transformed_joints, 0.0));
+        continue;
+      }
       features.push_back(vector<double> (0));
       features.at(features.size() - 1) = computeSkelObjFeatures(frame.skeleton, frame.objects.at(i));
     }
@@ -114,8 +121,8 @@ class Segment {
 
   void computeObjFeatures(bool normalize) {
     int numFrames = frames.size();
-    Frame ff = frames.at(0);
-    Frame fl = frames.at(frames.size() - 1);
+    Frame &ff = frames.at(0);
+    Frame &fl = frames.at(frames.size() - 1);
     for (size_t i = 0; i < ff.objects.size(); i++) {
         obj_features.push_back(vector<double>(0));
     }
@@ -167,25 +174,39 @@ class Segment {
     int numFrames = frames.size();
     bool started = false;
     bool added = false;
-    Frame frame = frames.at(floor(frames.size() / 2));
+    Frame &frame = frames.at(floor(frames.size() / 2));
     int numFeats=0;
-    started = features_skeleton->extractSkeletonFeature(frame.skeleton.data, frame.skeleton.pos_data);
-    if (started) {
-      skel_features = features_skeleton->getFeatureValues();
+    if (frame.skeleton.tracked) {
+      double *data[JOINT_NUM], *pos_data[POS_JOINT_NUM];
+      frame.skeleton.getRows(data, pos_data);
+      started = features_skeleton->extractSkeletonFeature(data, pos_data);
+      if (started) {
+        skel_features = features_skeleton->getFeatureValues();
+      }
+    } else {
+      skel_features = FeaturesSkel::getDefaultFeatureValues();
     }
     // distance and displacement
+    // zero between frames either of which is untracked
     FrameSkel sf = frames.at(0).skeleton;
     FrameSkel sl = frames.at(frames.size() - 1).skeleton;
+    bool endsTracked = sf.tracked && sl.tracked;
     double dist;
-    for (size_t i = 0; i < sf.transformed_joints.size(); i++) {
-      double x = sf.transformed_joints.at(i).x - sl.transformed_joints.at(i).x;
-      double y = sf.transformed_joints.at(i).y - sl.transformed_joints.at(i).y;
-      double z = sf.transformed_joints.at(i).z - sl.transformed_joints.at(i).z;
-      double distance = getDistanceSqrBwPoints(sf.transformed_joints.at(i), sl.transformed_joints.at(i));
+    for (int i = 0; i < sf.num_transformed_joints; i++) {
+      double x = 0, y = 0, z = 0, distance = 0;
+      if (endsTracked) {
+        x = sf.transformed_joints[i].x - sl.transformed_joints[i].x;
+        y = sf.transformed_joints[i].y - sl.transformed_joints[i].y;
+        z = sf.transformed_joints[i].z - sl.transformed_joints[i].z;
+        distance = getDistanceSqrBwPoints(sf.transformed_joints[i], sl.transformed_joints[i]);
+      }
       double totalDistance = 0;
 
       for (size_t j = 1; j < frames.size(); j++) {
-        totalDistance += getDistanceSqrBwPoints(frames.at(j - 1).skeleton.transformed_joints.at(i), frames.at(j).skeleton.transformed_joints.at(i));
+        if (!frames.at(j - 1).skeleton.tracked || !frames.at(j).skeleton.tracked) {
+          continue;
+        }
+        totalDistance += getDistanceSqrBwPoints(frames.at(j - 1).skeleton.transformed_joints[i], frames.at(j).skeleton.transformed_joints[i]);
       }
       if(normalize){x = x/ numFrames; y = y/ numFrames; z = z /numFrames; distance = distance/numFrames; totalDistance = totalDistance/numFrames;}
       skel_features.push_back(x);
@@ -200,26 +221,40 @@ class Segment {
     int numFrames = frames.size();
     bool started = false;
     bool added = false;
-    Frame frame = frames.at(floor(frames.size() / 2));
+    Frame &frame = frames.at(floor(frames.size() / 2));
     int numFeats=0;
 
-    started = features_skeleton->extractSkeletonFeature(frame.skeleton.data, frame.skeleton.pos_data);
-    if (started) {
-      skel_features = features_skeleton->getFeatureValues();
+    if (frame.skeleton.tracked) {
+      double *data[JOINT_NUM], *pos_data[POS_JOINT_NUM];
+      frame.skeleton.getRows(data, pos_data);
+      started = features_skeleton->extractSkeletonFeature(data, pos_data);
+      if (started) {
+        skel_features = features_skeleton->getFeatureValues();
+      }
+    } else {
+      skel_features = FeaturesSkel::getDefaultFeatureValues();
     }
     // distance and displacement
+    // zero between frames either of which is untracked
     FrameSkel sf = frames.at(0).skeleton;
     FrameSkel sl = frames.at(frames.size() - 1).skeleton;
+    bool endsTracked = sf.tracked && sl.tracked;
     double dist;
-    for (size_t i = 0; i < sf.transformed_joints.size(); i++) {
-      double x = sf.transformed_joints.at(i).x - sl.transformed_joints.at(i).x;
-      double y = sf.transformed_joints.at(i).y - sl.transformed_joints.at(i).y;
-      double z = sf.transformed_joints.at(i).z - sl.transformed_joints.at(i).z;
-      double distance = getDistanceSqrBwPoints(sf.transformed_joints.at(i), sl.transformed_joints.at(i));
+    for (int i = 0; i < sf.num_transformed_joints; i++) {
+      double x = 0, y = 0, z = 0, distance = 0;
+      if (endsTracked) {
+        x = sf.transformed_joints[i].x - sl.transformed_joints[i].x;
+        y = sf.transformed_joints[i].y - sl.transformed_joints[i].y;
+        z = sf.transformed_joints[i].z - sl.transformed_joints[i].z;
+        distance = getDistanceSqrBwPoints(sf.transformed_joints[i], sl.transformed_joints[i]);
+      }
       double totalDistance = 0;
 
       for (size_t j = 1; j < frames.size(); j++) {
-        totalDistance += getDistanceSqrBwPoints(frames.at(j - 1).skeleton.transformed_joints.at(i), frames.at(j).skeleton.transformed_joints.at(i));
+        if (!frames.at(j - 1).skeleton.tracked || !frames.at(j).skeleton.tracked) {
+          continue;
+        }
+        totalDistance += getDistanceSqrBwPoints(frames.at(j - 1).skeleton.transformed_joints[i], frames.at(j).skeleton.transformed_joints[i]);
       }
       if(normalize){x = x/ numFrames; y = y/ numFrames; z = z /numFrames; distance = distance/numFrames; totalDistance = totalDistance/numFrames;}
       skel_features.push_back(x);
@@ -290,12 +325,18 @@ class Segment {
     for (size_t i = 0; i < numObjs; i++) {
       skel_obj_features.push_back(vector<double> (0));
       vector<double> min(features.at(0).at(objCount).size(), FLT_MAX), max(features.at(0).at(objCount).size(), FLT_MIN);
+      int numTracked = 0;
       for (size_t k = 0; k < frames.size(); k++) {
         // store the features of the first , middle and last frames
         if (k == 0 || k == frames.size() - 1 || k == floor((frames.size() - 1) / 2)) {
             skel_obj_features.at(objCount).insert(skel_obj_features.at(objCount).end(), features.at(k).at(objCount).begin(), features.at(k).at(objCount).end());
         }
-        // compute the min and max of distances and displacements
+        // compute the min and max of distances and displacements, over the
+        // frames with a valid skeleton
+        if (!frames.at(k).skeleton.tracked) {
+          continue;
+        }
+        numTracked++;
         for (size_t z = 0; z < min.size(); z++) {
             if (features.at(k).at(objCount).at(z) < min.at(z))
                 min.at(z) = features.at(k).at(objCount).at(z);
@@ -303,6 +344,10 @@ class Segment {
                 max.at(z) = features.at(k).at(objCount).at(z);
         }
       }
+      if (numTracked == 0) {
+        min.assign(min.size(), 0.0);
+        max.assign(max.size(), 0.0);
+      }
       if (normalize) {
         for (size_t z = 0; z < min.size(); z++) {
           min.at(z) = min.at(z) / numFrames;
@@ -333,6 +378,8 @@ class FeaturesMultiFrame {
 
   std::ofstream ofeatfile, sfeatfile, oofeatfile, sofeatfile;
   std::ofstream  temporalSkelfeatfile, temporalObjfeatfile;
+  // the segments whose middle frame has no valid skeleton
+  std::ofstream untrackedfile;
 
   void print_feats(vector<vector<double> > &feats) {
     for (size_t i = 0; i < feats.size(); i++) {
@@ -352,8 +399,8 @@ class FeaturesMultiFrame {
   }
 
   void computeObjTemporalFeatures(bool normalize ) {
-    Frame frameNew = segmentNew.frames.at(floor((segmentNew.frames.size()-1)/2));
-    Frame frameOld = segmentOld.frames.at(floor((segmentOld.frames.size()-1)/2));
+    Frame &frameNew = segmentNew.frames.at(floor((segmentNew.frames.size()-1)/2));
+    Frame &frameOld = segmentOld.frames.at(floor((segmentOld.frames.size()-1)/2));
     int numFrame = frameNew.frameNum - frameOld.frameNum;
     for (size_t i = 0; i < frameNew.objects.size(); i++) {
       obj_temporal_features.push_back(vector<double>(0));
@@ -374,8 +421,8 @@ class FeaturesMultiFrame {
 
 
   void computeObjTemporalFeaturesAdj(bool normalize ) {
-    Frame frameNew = segmentNew.frames.at(0);
-    Frame frameOld = segmentOld.frames.at(segmentOld.frames.size()-1);
+    Frame &frameNew = segmentNew.frames.at(0);
+    Frame &frameOld = segmentOld.frames.at(segmentOld.frames.size()-1);
     int numFrame = frameNew.frameNum - frameOld.frameNum;
     for (size_t i = 0; i < frameNew.objects.size(); i++) {
       obj_temporal_features.push_back(vector<double>(0));
@@ -396,17 +443,22 @@ class FeaturesMultiFrame {
 
 
   void computeSkelTemporalFeatures(bool normalize) {
-    Frame frameNew = segmentNew.frames.at(floor((segmentNew.frames.size()-1)/2));
-    Frame frameOld = segmentOld.frames.at(floor((segmentOld.frames.size()-1)/2));
+    Frame &frameNew = segmentNew.frames.at(floor((segmentNew.frames.size()-1)/2));
+    Frame &frameOld = segmentOld.frames.at(floor((segmentOld.frames.size()-1)/2));
     int numFrame = frameNew.frameNum - frameOld.frameNum;
-    // distance between of local joints positions
+    bool tracked = frameNew.skeleton.tracked && frameOld.skeleton.tracked;
+    // distance between of local joints positions, zero if either skeleton is
+    // untracked
     for (size_t i = 0; i < frameNew.skeleton.num_local_joints; i++) {
-      double dist = pow((frameNew.skeleton.joints_local[i][pos_data_x]
-                        - frameOld.skeleton.joints_local[i][pos_data_x]), 2)
-                    + pow((frameNew.skeleton.joints_local[i][pos_data_y]
-                          - frameOld.skeleton.joints_local[i][pos_data_y]), 2)
-                    + pow((frameNew.skeleton.joints_local[i][pos_data_z]
-                          - frameOld.skeleton.joints_local[i][pos_data_z]), 2);
+      double dist = 0;
+      if (tracked) {
+        dist = pow((frameNew.skeleton.joints_local[i][pos_data_x]
+                    - frameOld.skeleton.joints_local[i][pos_data_x]), 2)
+               + pow((frameNew.skeleton.joints_local[i][pos_data_y]
+                      - frameOld.skeleton.joints_local[i][pos_data_y]), 2)
+               + pow((frameNew.skeleton.joints_local[i][pos_data_z]
+                      - frameOld.skeleton.joints_local[i][pos_data_z]), 2);
+      }
       skel_temporal_features.push_back(dist);
       if(normalize){skel_temporal_features.push_back(dist/numFrame);}
     }
@@ -416,17 +468,22 @@ class FeaturesMultiFrame {
   }
 
   void computeSkelTemporalFeaturesAdj(bool normalize) {
-    Frame frameNew = segmentNew.frames.at(0);
-    Frame frameOld = segmentOld.frames.at(segmentOld.frames.size()-1);
+    Frame &frameNew = segmentNew.frames.at(0);
+    Frame &frameOld = segmentOld.frames.at(segmentOld.frames.size()-1);
     int numFrame = frameNew.frameNum - frameOld.frameNum;
-    // distance between of local joints positions
+    bool tracked = frameNew.skeleton.tracked && frameOld.skeleton.tracked;
+    // distance between of local joints positions, zero if either skeleton is
+    // untracked
     for (size_t i = 0; i < frameNew.skeleton.num_local_joints; i++) {
-      double dist = pow((frameNew.skeleton.joints_local[i][pos_data_x]
-                        - frameOld.skeleton.joints_local[i][pos_data_x]), 2)
-                    + pow((frameNew.skeleton.joints_local[i][pos_data_y]
-                          - frameOld.skeleton.joints_local[i][pos_data_y]), 2)
-                    + pow((frameNew.skeleton.joints_local[i][pos_data_z]
-                          - frameOld.skeleton.joints_local[i][pos_data_z]), 2);
+      double dist = 0;
+      if (tracked) {
+        dist = pow((frameNew.skeleton.joints_local[i][pos_data_x]
+                    - frameOld.skeleton.joints_local[i][pos_data_x]), 2)
+               + pow((frameNew.skeleton.joints_local[i][pos_data_y]
+                      - frameOld.skeleton.joints_local[i][pos_data_y]), 2)
+               + pow((frameNew.skeleton.joints_local[i][pos_data_z]
+                      - frameOld.skeleton.joints_local[i][pos_data_z]), 2);
+      }
       skel_temporal_features.push_back(dist);
       if(normalize){skel_temporal_features.push_back(dist/numFrame);}
     }
@@ -487,6 +544,10 @@ class FeaturesMultiFrame {
     writeSkelFeats();
     writeObjObjFeats();
     writeSkelObjFeats();
+    if (!segmentNew.frames.at(floor(segmentNew.frames.size() / 2)).skeleton.tracked) {
+      untrackedfile << segmentNew.frames.at(0).sequenceId << ","
+                    << segmentNew.segmentId << endl;
+    }
   }
 
   void computeTemporalFreatures(bool normalize) {
@@ -519,18 +580,23 @@ class FeaturesMultiFrame {
     }
   }
 
-  FeaturesMultiFrame(bool Temporal) {
+  // the names of the feature files start with prefix
+  FeaturesMultiFrame(bool Temporal, const string &prefix = "") {
     mirrored = false;
     temporal = Temporal;
     segmentCount = 0;
     temporalFlag = false;
-    ofeatfile.open("data_obj_feats.txt", ios::app);
-    sfeatfile.open("data_skel_feats.txt", ios::app);
-    oofeatfile.open("data_obj_obj_feats.txt", ios::app);
-    sofeatfile.open("data_skel_obj_feats.txt", ios::app);
+    ofeatfile.open((prefix + "data_obj_feats.txt").c_str(), ios::app);
+    sfeatfile.open((prefix + "data_skel_feats.txt").c_str(), ios::app);
+    oofeatfile.open((prefix + "data_obj_obj_feats.txt").c_str(), ios::app);
+    sofeatfile.open((prefix + "data_skel_obj_feats.txt").c_str(), ios::app);
+    untrackedfile.open((prefix + "data_skel_untracked.txt").c_str(),
+                       ios::app);
     if (temporal) {
-      temporalObjfeatfile.open("data_temporal_obj_feats.txt", ios::app);
-      temporalSkelfeatfile.open("data_temporal_skel_feats.txt", ios::app);
+      temporalObjfeatfile.open((prefix + "data_temporal_obj_feats.txt").c_str(),
+                               ios::app);
+      temporalSkelfeatfile.open(
+          (prefix + "data_temporal_skel_feats.txt").c_str(), ios::app);
     }
   }
 
@@ -539,6 +605,7 @@ class FeaturesMultiFrame {
     sfeatfile.close();
     oofeatfile.close();
     sofeatfile.close();
+    untrackedfile.close();
     if (temporal) {
       temporalSkelfeatfile.close();
       temporalObjfeatfile.close();
@@ -10,8 +10,9 @@ Copyright (C) 2012 Hema Koppula
 
 ObjectProfile::ObjectProfile(vector<double> &feats,
                              pcl::PointCloud<PointT> &fullCloud,
-                             map<int, int> &tablePoints, int id,
-                             string transFile) {
+                             PixelMask &tablePoints, int id,
+                             string transFile,
+                             ObjectTracker *tracker) {
   features = feats;
   transformfile = transFile;
   minX = features.at(2);
@@ -19,13 +20,14 @@ ObjectProfile::ObjectProfile(vector<double> &feats,
   maxX = features.at(4);
   maxY = features.at(5);
   objID = id;
-  getObjectPointCloud(fullCloud, tablePoints);
-  initialize();
+  getObjectIndices(fullCloud, tablePoints, tracker);
+  initialize(fullCloud);
 }
 
 ObjectProfile::ObjectProfile(vector<double> &feats,
                              pcl::PointCloud<PointT> &fullCloud,
-                             map<int, int> &tablePoints, int id) {
+                             PixelMask &tablePoints, int id,
+                             ObjectTracker *tracker) {
   features = feats;
   transformfile = "";
   minX = features.at(2);
@@ -33,14 +35,14 @@ ObjectProfile::ObjectProfile(vector<double> &feats,
   maxX = features.at(4);
   maxY = features.at(5);
   objID = id;
-  getObjectPointCloud(fullCloud, tablePoints);
-  initialize();
+  getObjectIndices(fullCloud, tablePoints, tracker);
+  initialize(fullCloud);
 }
 
 ObjectProfile::ObjectProfile(vector<double> &feats,
                              pcl::PointCloud<PointT> &fullCloud,
-                             map<int, int> &tablePoints, int id,
-                             string transFile, vector<int> &PCInds) {
+                             PixelMask &tablePoints, int id,
+                             string transFile, const vector<int> &PCInds) {
   features = feats;
   transformfile = transFile;
   minX = features.at(2);
@@ -49,27 +51,57 @@ ObjectProfile::ObjectProfile(vector<double> &feats,
   maxY = features.at(5);
   objID = id;
   if (PCInds.size() > 10) {
-    getObjectPointCloud(fullCloud, PCInds);
-    initialize();
     pcInds = PCInds;
   }
-}
-
-void ObjectProfile::initialize() {
+  initialize(fullCloud);
+}
+
+ObjectProfile::ObjectProfile()
+    : avgH(0), avgS(0), avgV(0), minX(0), minY(0), maxX(0), maxY(0),
+      objID(0) {
+}
+
+void ObjectProfile::swap(ObjectProfile &other) {
+  eigenValues.swap(other.eigenValues);
+  features.swap(other.features);
+  pcInds.swap(other.pcInds);
+  transformfile.swap(other.transformfile);
+  objectType.swap(other.objectType);
+  std::swap(avgHOGFeatsOfObject, other.avgHOGFeatsOfObject);
+  std::swap(avgH, other.avgH);
+  std::swap(avgS, other.avgS);
+  std::swap(avgV, other.avgV);
+  std::swap(minX, other.minX);
+  std::swap(minY, other.minY);
+  std::swap(maxX, other.maxX);
+  std::swap(maxY, other.maxY);
+  std::swap(objID, other.objID);
+  std::swap(centroid, other.centroid);
+  std::swap(center, other.center);
+  std::swap(normal, other.normal);
+}
+
+void ObjectProfile::initialize(const pcl::PointCloud<PointT> &fullCloud) {
   Eigen::Matrix3d eigen_vectors;
   Eigen::Vector3d eigen_values;
-  computeCentroid();
   computeCenter();
+  if (pcInds.empty()) {
+    centroid.x = 0;
+    centroid.y = 0;
+    centroid.z = 0;
+    normal.setZero();
+    eigenValues.assign(3, 0);
+    return;
+  }
+  // computes the centroid as well
   Eigen::Matrix3d covariance_matrix;
-  computeCovarianceMatrix(cloud, covariance_matrix, centroid);
+  computeCovarianceMatrix(fullCloud, pcInds, covariance_matrix, centroid);
   for (unsigned int i = 0; i < 3; i++) {
     for (unsigned int j = 0; j < 3; j++) {
-      covariance_matrix(i, j) /= static_cast<double> (cloud.points.size());
+      covariance_matrix(i, j) /= static_cast<double> (pcInds.size());
     }
   }
-  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> ei_symm(covariance_matrix);
-  eigen_values = ei_symm.eigenvalues();
-  eigen_vectors = ei_symm.eigenvectors();
+  computeEigen3x3(covariance_matrix, eigen_values, eigen_vectors);
 
   setEigValues(eigen_values);
   float minEigV = FLT_MAX;
@@ -94,6 +126,70 @@ void ObjectProfile::initialize() {
   assert(minEigV == getDescendingLambda(2));
 }
 
+bool ObjectProfile::estimate(vector<double> &feats,
+                             const pcl::PointCloud<PointT> &fullCloud,
+                             int id, string transFile,
+                             const vector<int> &candidates) {
+  features = feats;
+  transformfile = transFile;
+  minX = features.at(2);
+  minY = features.at(3);
+  maxX = features.at(4);
+  maxY = features.at(5);
+  objID = id;
+  PointT origin;
+  origin.x = 0;
+  origin.y = 0;
+  origin.z = 0;
+  if (transformfile != "") {
+    TransformG globalTransform = readTranform(transformfile);
+    globalTransform.transformPointInPlace(origin);
+  }
+  // same range as filterCloud
+  int stride = std::max(1, static_cast<int>(candidates.size())
+                           / FAST_SAMPLE_SIZE);
+  vector<int> sample;
+  vector<float> dists;
+  for (size_t i = 0; i < candidates.size(); i += stride) {
+    const PointT &point = fullCloud.points.at(candidates[i]);
+    float dist_from_cam = sqrt(sqr(origin.x - point.x) +
+                               sqr(origin.y - point.y) +
+                               sqr(origin.z - point.z));
+    if (dist_from_cam < 2500 && dist_from_cam > 500) {
+      sample.push_back(candidates[i]);
+      dists.push_back(dist_from_cam);
+    }
+  }
+  pcInds.clear();
+  if (sample.size() <= 10) {
+    return false;
+  }
+  vector<float> sorted(dists);
+  std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2,
+                   sorted.end());
+  float median = sorted[sorted.size() / 2];
+  for (size_t i = 0; i < sample.size(); i++) {
+    if (fabs(dists[i] - median) < FAST_DEPTH_BAND) {
+      pcInds.push_back(sample[i]);
+    }
+  }
+  initialize(fullCloud);
+  return true;
+}
+
+void ObjectProfile::getBoxIndices(const vector<double> &feats,
+                                  vector<int> &indices) {
+  int minX = feats.at(2), minY = feats.at(3);
+  int maxX = feats.at(4), maxY = feats.at(5);
+  indices.clear();
+  indices.reserve((maxY - minY + 1)*(maxX - minX + 1));
+  for (int y = minY; y <= maxY; y++) {
+    for (int x = minX; x <= maxX; x++) {
+      indices.push_back(y * X_RES + x);
+    }
+  }
+}
+
 void ObjectProfile::setObjectType(string type) {
   objectType = type;
 }
@@ -102,45 +198,27 @@ string ObjectProfile::getObjectType() {
   return objectType;
 }
 
-void ObjectProfile::getObjectPointCloud(pcl::PointCloud<PointT> &fullCloud,
-                                        vector<int> &PCInds) {
-  int index = 0;
+void ObjectProfile::getObjectPointCloud(
+    const pcl::PointCloud<PointT> &fullCloud,
+    pcl::PointCloud<PointT> &cloud) const {
   cloud.height = 1;
-  cloud.width = PCInds.size();
+  cloud.width = pcInds.size();
   cloud.points.resize(cloud.height * cloud.width);
-
-  int objIndex = 0;
-  for (size_t i = 0; i < PCInds.size(); i++) {
-    index = PCInds.at(i);
-    cloud.points.at(i) = fullCloud.points.at(index);
+  for (size_t i = 0; i < pcInds.size(); i++) {
+    cloud.points.at(i) = fullCloud.points.at(pcInds.at(i));
   }
 }
 
-void ObjectProfile::getObjectPointCloud(pcl::PointCloud<PointT> &fullCloud,
-                                        map<int, int> &tablePoints) {
-  int index = 0;
-  cloud.height = 1;
-  cloud.width = (maxY - minY + 1)*(maxX - minX + 1);
-  cloud.points.resize(cloud.height * cloud.width);
-  map<int, int> localTablePoints;
-  int objIndex = 0;
-  for (int y = minY; y <= maxY; y++) {
-    for (int x = minX; x <= maxX; x++) {
-      index = y * X_RES + x;
-      cloud.points.at(objIndex) = fullCloud.points.at(index);
-      if (tablePoints.find(index) != tablePoints.end()) {
-        localTablePoints[objIndex] = 1;
-      }
-      objIndex++;
-    }
-  }
-  filterCloud(localTablePoints);
-  char filename[20];
-  sprintf(filename, "obj_%d.pcd", objID);
-  pcl::io::savePCDFileBinary(filename, cloud);
+void ObjectProfile::getObjectIndices(const pcl::PointCloud<PointT> &fullCloud,
+                                     PixelMask &tablePoints,
+                                     ObjectTracker *tracker) {
+  getBoxIndices(features, pcInds);
+  filterCloud(fullCloud, tablePoints, tracker);
 }
 
-void ObjectProfile::filterCloud(map<int, int> &tablePoints) {
+void ObjectProfile::filterCloud(const pcl::PointCloud<PointT> &fullCloud,
+                                PixelMask &tablePoints,
+                                ObjectTracker *tracker) {
   // remove points too far from the camera (eg walls)
   PointT origin;
   origin.x = 0;
@@ -152,25 +230,43 @@ void ObjectProfile::filterCloud(map<int, int> &tablePoints) {
     globalTransform.transformPointInPlace(origin);
   }
   vector<int> indices;
-  for (int i = 0; i < cloud.size(); i++) {
-    double dist_from_cam = sqrt(sqr(origin.x - cloud.points[i].x) +
-                                sqr(origin.y - cloud.points[i].y) +
-                                sqr(origin.z - cloud.points[i].z));
+  for (size_t i = 0; i < pcInds.size(); i++) {
+    const PointT &point = fullCloud.points.at(pcInds[i]);
+    double dist_from_cam = sqrt(sqr(origin.x - point.x) +
+                                sqr(origin.y - point.y) +
+                                sqr(origin.z - point.z));
     if (dist_from_cam < 2500 && dist_from_cam > 500 &&
-        tablePoints.find(i) == tablePoints.end()) {
-      indices.push_back(i);
+        !tablePoints.test(pcInds[i])) {
+      indices.push_back(pcInds[i]);
     }
   }
-  pcl::PointCloud<PointT> temp_cloud;
-  temp_cloud = cloud;
-  cloud.points.resize(indices.size());
-  cloud.width = indices.size();
-  for (int i = 0; i < indices.size(); i++) {
-    if (i != indices[i])
-      cloud.points[i] = temp_cloud.points[indices[i]];
+  pcInds.swap(indices);
+  bool tracked = tracker != NULL &&
+      tracker->trackObject(objID, fullCloud, pcInds, indices);
+  if (pcInds.empty()) {
+    // nothing in range, there is no cluster
+    indices.clear();
+  } else if (!tracked || tracker->validating()) {
+    // cluster and then retain the biggest cluster
+    pcl::PointCloud<PointT> cloud;
+    getObjectPointCloud(fullCloud, cloud);
+    pcl::PointIndices clusterInds;
+    getMaxCluster(cloud, clusterInds);
+    vector<int> clustered(clusterInds.indices.size());
+    for (size_t i = 0; i < clusterInds.indices.size(); i++) {
+      clustered[i] = pcInds[clusterInds.indices[i]];
+    }
+    if (tracked) {
+      std::sort(clustered.begin(), clustered.end());
+      tracker->addValidation(indices, clustered);
+    } else {
+      indices.swap(clustered);
+    }
+  }
+  pcInds.swap(indices);
+  if (tracker != NULL) {
+    tracker->setCluster(objID, fullCloud, pcInds);
   }
-  // cluster and then retain the biggest cluster
-  getMaxCluster(cloud);
 }
 
 void ObjectProfile::setEigValues(Eigen::Vector3d eigenValues_) {
@@ -187,27 +283,32 @@ float ObjectProfile::getDescendingLambda(int index)  {
   return eigenValues[2 - index];
 }
 
-void ObjectProfile::computeCentroid() {
+void ObjectProfile::computeCentroid(
+    const pcl::PointCloud<PointT> &fullCloud) {
   centroid.x = 0;
   centroid.y = 0;
   centroid.z = 0;
-  for (size_t i = 0; i < cloud.points.size(); i++) {
-    centroid.x += cloud.points.at(i).x;
-    centroid.y += cloud.points.at(i).y;
-    centroid.z += cloud.points.at(i).z;
+  for (size_t i = 0; i < pcInds.size(); i++) {
+    centroid.x += fullCloud.points.at(pcInds[i]).x;
+    centroid.y += fullCloud.points.at(pcInds[i]).y;
+    centroid.z += fullCloud.points.at(pcInds[i]).z;
   }
-  centroid.x = centroid.x / cloud.points.size();
-  centroid.y = centroid.y / cloud.points.size();
-  centroid.z = centroid.z / cloud.points.size();
+  centroid.x = centroid.x / pcInds.size();
+  centroid.y = centroid.y / pcInds.size();
+  centroid.z = centroid.z / pcInds.size();
 }
 
-double ObjectProfile::getMinDistanceTo(pcl::PointXYZ p) {
+double ObjectProfile::getMinDistanceTo(
+    const pcl::PointCloud<PointT> &fullCloud, pcl::PointXYZ p) {
   double minDist = 100000000;
   double dist = 0;
-  for (size_t i = 0; i < cloud.points.size(); i++) {
-    dist = pow(p.x - cloud.points.at(i).x, 2) +
-           pow(p.y - cloud.points.at(i).y, 2) +
-           pow(p.z - cloud.points.at(i).z, 2);
+  for (size_t i = 0; i < pcInds.size(); i++) {
+    const PointT &point = fullCloud.points.at(pcInds[i]);
+    // in double, the coordinates are widened before they are subtracted
+    double dx = static_cast<double>(p.x) - point.x;
+    double dy = static_cast<double>(p.y) - point.y;
+    double dz = static_cast<double>(p.z) - point.z;
+    dist = dx * dx + dy * dy + dz * dz;
     if (dist< minDist) {
       minDist = dist;
     }
@@ -386,8 +487,7 @@ void Frame::createPointCloud(int ***IMAGE, string transformfile) {
     pcl::PointIndices tablePointInds;
     getTableInds(cloud, tablePointInds);
     cout << "size of table :" << tablePointInds.indices.size() << endl;
-    for (size_t i = 0; i < tablePointInds.indices.size(); i++)
-      tablePoints[tablePointInds.indices.at(i)] = 1;
+    tablePoints.set(tablePointInds.indices);
   }
   TransformG globalTransform;
   globalTransform = readTranform(transformfile);
@@ -421,8 +521,7 @@ void Frame::createPointCloud(int ***IMAGE) {
       pcl::PointIndices tablePointInds;
       getTableInds(cloud, tablePointInds);
       cout << "size of table :" << tablePointInds.indices.size() << endl;
-      for (size_t i = 0; i < tablePointInds.indices.size(); i++)
-        tablePoints[tablePointInds.indices.at(i)] = 1;
+      tablePoints.set(tablePointInds.indices);
   }
 }
 
@@ -437,25 +536,20 @@ void Frame::computeAggHogBlock(int numStripes, int minXBlock, int maxXBlock,
   // blocks in one stripe in the image.
   double stripeSize = (static_cast<double>(maxYBlock - minYBlock)) / numStripes;
 
+  HOG &frameHog = hog.get();
   for (int n = 0; n < numStripes; n++) {
-    // For each stripe, create a new HOGFeaturesOfBlock vector hogvec
-    // and fill it with the HOGFeaturesOfBlocks in this stripe.
-    std::vector<HOGFeaturesOfBlock> hogvec;
-    for (int j =  static_cast<int> (minYBlock + n * stripeSize);
-          j <=  static_cast<int> (minYBlock + (n + 1) * stripeSize); j++) {
-      for (int i = minXBlock; i <= maxXBlock; i++) {
-        HOGFeaturesOfBlock hfob;
-        hog.getFeatVec(j, i, hfob);
-        hogvec.push_back(hfob);
-      }
-    }
-    // Now compute the aggregate features for this stripe,
-    // and store the aggregate as its own
-    // HOGFeaturesOfBlock in the aggHogVec vector.
-    HOGFeaturesOfBlock::aggregateFeatsOfBlocks(hogvec, hogObject);
+    // the aggregate features of the blocks in this stripe
+    frameHog.getMeanFeatVec(static_cast<int> (minYBlock + n * stripeSize),
+                            static_cast<int> (minYBlock + (n + 1) * stripeSize),
+                            minXBlock, maxXBlock, hogObject);
   }
 }
 
+BlockRect Frame::getObjectBlocks(const ObjectProfile &obj) {
+  return BlockRect(obj.minX / BLOCK_SIDE, obj.minY / BLOCK_SIDE,
+                   obj.maxX / BLOCK_SIDE, obj.maxY / BLOCK_SIDE);
+}
+
 void Frame::computeObjectHog() {
   const int numStripes = 1;
   // for each object
@@ -463,33 +557,27 @@ void Frame::computeObjectHog() {
   for (vector<ObjectProfile>::iterator it = objects.begin();
         it != objects.end(); it++) {
     count++;
-    int minXBlock = static_cast<int> ((*it).minX / BLOCK_SIDE);
-    int minYBlock = static_cast<int> ((*it).minY / BLOCK_SIDE);
-    int maxXBlock = static_cast<int> ((*it).maxX / BLOCK_SIDE);
-    int maxYBlock = static_cast<int> ((*it).maxY / BLOCK_SIDE);
-    computeAggHogBlock(numStripes, minXBlock, maxXBlock, minYBlock, maxYBlock,
-                       it->avgHOGFeatsOfObject);
+    BlockRect blocks = getObjectBlocks(*it);
+    computeAggHogBlock(numStripes, blocks.minX, blocks.maxX, blocks.minY,
+                       blocks.maxY, it->avgHOGFeatsOfObject);
   }
 }
 
-void Frame::computeHogDescriptors() {
-  CvSize size;
-  size.height = Y_RES;
-  size.width = X_RES;
-  IplImage * image = cvCreateImage(size, IPL_DEPTH_32F, 3);
-  assert(cloud.size() == size.width * size.height);
-  PointT tmp;
-  for (int x = 0; x < size.width; x++)
-    for (int y = 0; y < size.height; y++) {
-      int index = x + y * size.width;
-      tmp = cloud.points[index];
-      ColorRGB tmpColor(tmp.rgb);
-      CV_IMAGE_ELEM(image, float, y, 3 * x) = tmpColor.b;
-      CV_IMAGE_ELEM(image, float, y, 3 * x + 1) = tmpColor.g;
-      CV_IMAGE_ELEM(image, float, y, 3 * x + 2) = tmpColor.r;
-    }
-  hog.computeHog(image);
-  cvReleaseImage(&image);
+void Frame::startHog() {
+  assert(cloud.size() == X_RES * Y_RES);
+  // the colors are packed into rgb as blue, green and red bytes (little
+  // endian), HOG reads them in place
+  const unsigned char *colors =
+      reinterpret_cast<const unsigned char *>(&cloud.points[0].rgb);
+  ByteImageView image(colors, X_RES, Y_RES, 3, sizeof(PointT),
+                      X_RES * sizeof(PointT), 1);
+  // the colors of the cloud are in [0, 1]
+  hog.reset(image, 255.0);
+  // the blocks of the objects, see computeObjectHog
+  for (vector<ObjectProfile>::iterator it = objects.begin();
+        it != objects.end(); it++) {
+    hog.addBlocks(getObjectBlocks(*it));
+  }
 }
 
 void Frame::printHOGFeats() {
@@ -506,7 +594,24 @@ void Frame::printHOGFeats() {
 }
 
 void Frame::savePointCloud() {
-  pcl::io::savePCDFileBinary("test_pcd.pcd", cloud);
+  if (!debugWriter.isSampled(sequenceId, frameNum)) {
+    return;
+  }
+  pcl::PointCloud<PointT>::Ptr snapshot(new pcl::PointCloud<PointT>(cloud));
+  debugWriter.enqueue(sequenceId, frameNum, "cloud", snapshot);
+}
+
+void Frame::saveObjectPointClouds() {
+  if (!debugWriter.isSampled(sequenceId, frameNum)) {
+    return;
+  }
+  for (size_t i = 0; i < objects.size(); i++) {
+    pcl::PointCloud<PointT>::Ptr snapshot(new pcl::PointCloud<PointT>);
+    objects[i].getObjectPointCloud(cloud, *snapshot);
+    std::stringstream name;
+    name << "obj_" << objects[i].objID;
+    debugWriter.enqueue(sequenceId, frameNum, name.str(), snapshot);
+  }
 }
 
 void Frame::saveObjImage(ObjectProfile & obj, int ***IMAGE) {
@@ -555,51 +660,217 @@ void Frame::saveImage() {
 }
 
 
+ObjectModeStats::ObjectModeStats() : count(0) {
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    sumError[f] = 0;
+    maxError[f] = 0;
+  }
+}
+
+void ObjectModeStats::add(ObjectProfile &exact, ObjectProfile &fast) {
+  if (exact.pcInds.empty() || fast.pcInds.empty()) {
+    return;
+  }
+  double error[NUM_FEATURES];
+  error[0] = fabs(exact.centroid.x - fast.centroid.x);
+  error[1] = fabs(exact.centroid.y - fast.centroid.y);
+  error[2] = fabs(exact.centroid.z - fast.centroid.z);
+  // the normals are oriented towards the camera
+  double cosine = std::min(1.0, fabs(exact.normal.dot(fast.normal)));
+  error[3] = acos(cosine) * 180 / M_PI;
+  for (int l = 0; l < 3; l++) {
+    error[4 + l] = fabs(exact.getDescendingLambda(l)
+                        - fast.getDescendingLambda(l));
+  }
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    sumError[f] += error[f];
+    maxError[f] = std::max(maxError[f], error[f]);
+  }
+  count++;
+}
+
+void ObjectModeStats::print(std::ostream &out) const {
+  static const char *names[NUM_FEATURES] = {
+    "centroid x", "centroid y", "centroid z", "normal (degrees)",
+    "lambda 0", "lambda 1", "lambda 2"
+  };
+  out << "fast object mode, errors over " << count << " objects" << endl;
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    out << "  " << names[f] << ": mean "
+        << (count > 0 ? sumError[f] / count : 0) << ", max " << maxError[f]
+        << endl;
+  }
+}
+
+ObjectMode Frame::objectMode = OBJECT_MODE_EXACT;
+ObjectModeStats Frame::objectModeStats;
+DebugWriter Frame::debugWriter;
+FeaturesSkelRGBD Frame::skeletonRgbdFeatures(false);
+
+bool Frame::parseObjectMode(string option) {
+  if (option.compare("--object-mode=exact") == 0) {
+    objectMode = OBJECT_MODE_EXACT;
+  } else if (option.compare("--object-mode=fast") == 0) {
+    objectMode = OBJECT_MODE_FAST;
+  } else if (option.compare("--object-mode=validate") == 0) {
+    objectMode = OBJECT_MODE_VALIDATE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void Frame::addObject(ObjectProfile &obj) {
+  objects.push_back(ObjectProfile());
+  objects.back().swap(obj);
+}
+
+void Frame::addFastObject(vector<double> &feats, int id, string transformfile,
+                          const vector<int> &candidates, bool fromBox) {
+  ObjectProfile tmp;
+  if (tmp.estimate(feats, cloud, id, transformfile, candidates)) {
+    addObject(tmp);
+  } else if (fromBox) {
+    ObjectProfile exact(feats, cloud, tablePoints, id, transformfile);
+    addObject(exact);
+  } else {
+    ObjectProfile exact(feats, cloud, tablePoints, id, transformfile,
+                        candidates);
+    addObject(exact);
+  }
+}
+
+void Frame::validateObject(ObjectProfile &obj, vector<double> &feats,
+                           string transformfile,
+                           const vector<int> &candidates) {
+  if (objectMode != OBJECT_MODE_VALIDATE ||
+      (frameNum - 1) % VALIDATION_STRIDE != 0) {
+    return;
+  }
+  ObjectProfile fast;
+  // the fast mode would use the exact profile, there is nothing to compare
+  if (!fast.estimate(feats, cloud, obj.objID, transformfile, candidates)) {
+    return;
+  }
+  objectModeStats.add(obj, fast);
+}
+
 Frame::Frame() {
 }
 
+void Frame::swap(Frame &other) {
+  objFeats.swap(other.objFeats);
+  hog.swap(other.hog);
+  aggHogVec.swap(other.aggHogVec);
+  tablePoints.swap(other.tablePoints);
+  std::swap(findTable, other.findTable);
+  std::swap(frameNum, other.frameNum);
+  sequenceId.swap(other.sequenceId);
+  objects.swap(other.objects);
+  std::swap(skeleton, other.skeleton);
+  cloud.points.swap(other.cloud.points);
+  std::swap(cloud.header, other.cloud.header);
+  std::swap(cloud.width, other.cloud.width);
+  std::swap(cloud.height, other.cloud.height);
+  std::swap(cloud.is_dense, other.cloud.is_dense);
+  std::swap(cloud.sensor_origin_, other.cloud.sensor_origin_);
+  std::swap(cloud.sensor_orientation_, other.cloud.sensor_orientation_);
+  rgbdskel_feats.swap(other.rgbdskel_feats);
+}
+
+void Frame::copySegmentData(Frame &other) const {
+  other.frameNum = frameNum;
+  other.sequenceId = sequenceId;
+  other.objects = objects;
+  other.skeleton = skeleton;
+  other.rgbdskel_feats = rgbdskel_feats;
+}
+
+void Frame::getJointObjectDistances(vector<vector<double> > &distances) {
+  int numJoints = skeleton.num_transformed_joints;
+  distances.assign(numJoints, vector<double>(objects.size()));
+  for (int j = 0; j < numJoints; j++) {
+    for (size_t i = 0; i < objects.size(); i++) {
+      distances[j][i] = objects[i].getMinDistanceTo(
+          cloud, skeleton.transformed_joints[j]);
+    }
+  }
+}
+
 Frame::Frame(int ***IMAGE, double** data, double **pos_data,
              vector<vector<double> > &objFeats, string seqId, int fnum,
-             string transformfile)
-    : frameNum (fnum),
-      sequenceId (seqId),
-      findTable (false) {
+             string transformfile, ObjectTracker *tracker)
+    : frameNum(fnum),
+      sequenceId(seqId),
+      tablePoints(X_RES, Y_RES),
+      findTable(false) {
   createPointCloud(IMAGE, transformfile);
   savePointCloud();
   skeleton.initialize(data, pos_data, transformfile);
+  if (tracker != NULL) {
+    tracker->startFrame(sequenceId);
+  }
+  objects.reserve(objFeats.size());
   int count = 0;
   for (vector<vector<double> >::iterator it = objFeats.begin();
         it != objFeats.end(); it++) {
     count++;
-    ObjectProfile tmp(*it, cloud, tablePoints, count, transformfile);
-    objects.push_back(tmp);
+    vector<int> boxIndices;
+    ObjectProfile::getBoxIndices(*it, boxIndices);
+    if (objectMode == OBJECT_MODE_FAST) {
+      addFastObject(*it, count, transformfile, boxIndices, true);
+      continue;
+    }
+    ObjectProfile tmp(*it, cloud, tablePoints, count, transformfile,
+                      tracker);
+    validateObject(tmp, *it, transformfile, boxIndices);
+    addObject(tmp);
   }
-  computeHogDescriptors();
+  saveObjectPointClouds();
+  startHog();
   computeObjectHog();
 }
 
 Frame::Frame(int ***IMAGE, double** data, double **pos_data,
-             vector<vector<double> > &objFeats, string seqId, int fnum)
-   : frameNum (fnum),
-     sequenceId (seqId),
-     findTable (false) {
+             vector<vector<double> > &objFeats, string seqId, int fnum,
+             ObjectTracker *tracker, bool skeletonTracked)
+    : frameNum(fnum),
+      sequenceId(seqId),
+      tablePoints(X_RES, Y_RES),
+      findTable(false) {
   createPointCloud(IMAGE);
   skeleton.initialize(data, pos_data);
-  FeaturesSkelRGBD *features_skeleton_rgbd = new FeaturesSkelRGBD(false);
-  int numFeats;
-  rgbdskel_feats = features_skeleton_rgbd->computeFeatures(IMAGE, data,
-                                                           pos_data, numFeats,
-                                                           true, true, true,
-                                                           true, true, true,
-                                                           true, true, true);
+  skeleton.tracked = skeletonTracked;
+  if (tracker != NULL) {
+    tracker->startFrame(sequenceId);
+  }
+  objects.reserve(objFeats.size());
   int count = 0;
   for (vector<vector<double> >::iterator it = objFeats.begin();
        it != objFeats.end(); it++) {
     count++;
-    ObjectProfile tmp(*it, cloud, tablePoints, count);
-    objects.push_back(tmp);
+    vector<int> boxIndices;
+    ObjectProfile::getBoxIndices(*it, boxIndices);
+    if (objectMode == OBJECT_MODE_FAST) {
+      addFastObject(*it, count, "", boxIndices, true);
+      continue;
+    }
+    ObjectProfile tmp(*it, cloud, tablePoints, count, tracker);
+    validateObject(tmp, *it, "", boxIndices);
+    addObject(tmp);
+  }
+  saveObjectPointClouds();
+  startHog();
+  // the body parts are added to the HOG of the objects
+  if (skeleton.tracked) {
+    int numFeats;
+    rgbdskel_feats = skeletonRgbdFeatures.computeFeatures(IMAGE, data,
+                                                          pos_data, numFeats,
+                                                          true, true, true,
+                                                          true, true, true,
+                                                          true, true, true,
+                                                          &hog);
   }
-  computeHogDescriptors();
   computeObjectHog();
 }
 
@@ -607,23 +878,31 @@ Frame::Frame(int ***IMAGE, double** data, double **pos_data,
              vector<vector<double> > &objFeats, string seqId, int fnum,
              string transformfile, vector<vector<int> > &objPCInds,
              bool partial)
-    : frameNum (fnum),
-      sequenceId (seqId),
-      findTable (false) {
+    : frameNum(fnum),
+      sequenceId(seqId),
+      tablePoints(X_RES, Y_RES),
+      findTable(false) {
   createPointCloud(IMAGE, transformfile);
   if (partial) {
     skeleton.initialize_partial(data, pos_data, transformfile);
   } else {
     skeleton.initialize(data, pos_data, transformfile);
   }
+  objects.reserve(objFeats.size());
   int count = 0;
   for (size_t i = 0; i < objFeats.size(); i++) {
     count++;
+    if (objectMode == OBJECT_MODE_FAST) {
+      addFastObject(objFeats.at(i), count, transformfile, objPCInds.at(i),
+                    false);
+      continue;
+    }
     ObjectProfile tmp(objFeats.at(i), cloud, tablePoints, count, transformfile,
                       objPCInds.at(i));
-    objects.push_back(tmp);
+    validateObject(tmp, objFeats.at(i), transformfile, objPCInds.at(i));
+    addObject(tmp);
   }
-  computeHogDescriptors();
+  startHog();
   computeObjectHog();
 }
 
@@ -631,20 +910,29 @@ Frame::Frame(int ***IMAGE, double** data, double **pos_data,
              vector<vector<double> > &objFeats, string seqId, int fnum,
              string transformfile, vector<vector<int> > &objPCInds,
              vector<string> types)
-    : frameNum (fnum),
-      sequenceId (seqId),
-      findTable (false) {
+    : frameNum(fnum),
+      sequenceId(seqId),
+      tablePoints(X_RES, Y_RES),
+      findTable(false) {
   createPointCloud(IMAGE, transformfile);
   skeleton.initialize_partial(data, pos_data, transformfile);
+  objects.reserve(objFeats.size());
   int count = 0;
   for (size_t i = 0; i < objFeats.size(); i++) {
     count++;
+    if (objectMode == OBJECT_MODE_FAST) {
+      addFastObject(objFeats.at(i), count, transformfile, objPCInds.at(i),
+                    false);
+      objects.back().setObjectType(types.at(i));
+      continue;
+    }
     ObjectProfile tmp(objFeats.at(i), cloud, tablePoints, count,
                       transformfile, objPCInds.at(i));
     tmp.setObjectType(types.at(i));
-    objects.push_back(tmp);
+    validateObject(tmp, objFeats.at(i), transformfile, objPCInds.at(i));
+    addObject(tmp);
   }
-  computeHogDescriptors();
+  startHog();
   computeObjectHog();
 }
 
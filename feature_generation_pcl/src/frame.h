@@ -19,6 +19,9 @@ Copyright (C) 2012 Hema Koppula
 #include "includes/point_types.h"
 #include "includes/CombineUtils.h"
 #include "HOG.cpp"
+#include "pixel_mask.h"
+#include "objectTracker.h"
+#include "debugWriter.h"
 
 typedef pcl::PointXYZRGB PointT;
 
@@ -27,19 +30,35 @@ typedef pcl::PointXYZRGB PointT;
 
 using namespace std;
 
+class FeaturesSkelRGBD;
+
+// how the Frame constructors compute the object profiles
+enum ObjectMode {
+  // cluster the points of the bounding box, or use all the given indices
+  OBJECT_MODE_EXACT,
+  // estimate from a strided sample of the points near their median depth
+  OBJECT_MODE_FAST,
+  // exact, and compare against the estimate on a sample of the frames
+  OBJECT_MODE_VALIDATE
+};
+
 class ObjectProfile {
  private:
   vector<float> eigenValues;  // sorted in ascending order
+  // at most about this many points are sampled by estimate
+  static const int FAST_SAMPLE_SIZE = 512;
+  // sampled points further than this from the median depth are dropped
+  static const int FAST_DEPTH_BAND = 250;
 
  public:
   vector<double> features;
-  pcl::PointCloud<PointT> cloud;
   HOGFeaturesOfBlock avgHOGFeatsOfObject;
   float avgH;
   float avgS;
   float avgV;
   int minX, minY, maxX, maxY;
   int objID;
+  // indices of the object's points in the point cloud of its frame
   vector<int> pcInds;
   string transformfile;
   string objectType;
@@ -47,37 +66,63 @@ class ObjectProfile {
   pcl::PointXYZ center;
   Eigen::Vector3d normal;
 
+  // with a tracker the object's cluster is carried over from the last frame
   ObjectProfile(vector<double> &feats, pcl::PointCloud<PointT> &fullCloud,
-                map<int, int> &tablePoints, int id, string transFile);
+                PixelMask &tablePoints, int id, string transFile,
+                ObjectTracker *tracker = NULL);
 
   ObjectProfile(vector<double> &feats, pcl::PointCloud<PointT> &fullCloud,
-                map<int, int> &tablePoints, int id);
+                PixelMask &tablePoints, int id, ObjectTracker *tracker = NULL);
 
   ObjectProfile(vector<double> &feats, pcl::PointCloud<PointT> &fullCloud,
-                map<int, int> &tablePoints, int id, string transFile,
-                vector<int> &PCInds);
+                PixelMask &tablePoints, int id, string transFile,
+                const vector<int> &PCInds);
+
+  ObjectProfile();
+
+  // exchanges the contents of the two profiles without copying
+  void swap(ObjectProfile &other);
+
+  // without points the centroid, normal and eigen values are all zero
+  void initialize(const pcl::PointCloud<PointT> &fullCloud);
 
-  void initialize();
+  /*
+  Approximate profile, without the filtering and clustering of the exact
+  constructors: candidates, the indices of the pixels of the bounding box
+  or the object's indices, are sampled with a stride and the samples whose
+  distance from the camera is close to their median make up pcInds.
+  Returns false, without initializing the profile, if too few samples are in
+  range for an estimate.
+   */
+  bool estimate(vector<double> &feats, const pcl::PointCloud<PointT> &fullCloud,
+                int id, string transFile, const vector<int> &candidates);
+
+  // indices of the pixels of the bounding box given by feats
+  static void getBoxIndices(const vector<double> &feats, vector<int> &indices);
 
   void setObjectType(string);
 
   string getObjectType();
 
-  void getObjectPointCloud(pcl::PointCloud<PointT> &fullCloud,
-                           vector<int> &PCInds);
+  // copies the object's points out of the frame's point cloud
+  void getObjectPointCloud(const pcl::PointCloud<PointT> &fullCloud,
+                           pcl::PointCloud<PointT> &cloud) const;
 
-  void getObjectPointCloud(pcl::PointCloud<PointT> &fullCloud,
-                           map<int, int> &tablePoints);
+  void getObjectIndices(const pcl::PointCloud<PointT> &fullCloud,
+                        PixelMask &tablePoints, ObjectTracker *tracker = NULL);
 
-  void filterCloud(map<int, int> &tablePoints);
+  void filterCloud(const pcl::PointCloud<PointT> &fullCloud,
+                   PixelMask &tablePoints, ObjectTracker *tracker = NULL);
 
   void setEigValues(Eigen::Vector3d eigenValues_);
 
   float getDescendingLambda(int index);
 
-  void computeCentroid();
+  void computeCentroid(const pcl::PointCloud<PointT> &fullCloud);
 
-  double getMinDistanceTo(pcl::PointXYZ p);
+  // squared distance from p to the nearest point of the object
+  double getMinDistanceTo(const pcl::PointCloud<PointT> &fullCloud,
+                          pcl::PointXYZ p);
 
   double getDistanceToCentroid(pcl::PointXYZ p);
 
@@ -134,13 +179,33 @@ class ObjectProfile {
   void setFeatures(vector<double> &feat);
 };
 
+/*
+Errors of the fast object profiles against the exact ones, accumulated over
+the objects of the validated frames.
+ */
+class ObjectModeStats {
+ public:
+  ObjectModeStats();
+
+  void add(ObjectProfile &exact, ObjectProfile &fast);
+
+  // mean and maximum absolute error of each feature
+  void print(std::ostream &out) const;
+
+ private:
+  static const int NUM_FEATURES = 7;
+  int count;
+  double sumError[NUM_FEATURES];
+  double maxError[NUM_FEATURES];
+};
+
 class Frame {
  private:
   vector<vector<double> > objFeats;
-  HOG hog;
+  HOGContext hog;
   std::vector<HOGFeaturesOfBlock> aggHogVec;
   static const int BLOCK_SIDE = 8;
-  map<int, int> tablePoints;
+  PixelMask tablePoints;
   bool findTable;
 
   void createPointCloud(int ***IMAGE, string transformfile);
@@ -155,12 +220,39 @@ class Frame {
                           int minYBlock, int maxYBlock,
                           HOGFeaturesOfBlock &hogObject);
 
+  // the HOG blocks of the bounding box of obj
+  static BlockRect getObjectBlocks(const ObjectProfile &obj);
+
   void computeObjectHog();
 
-  void computeHogDescriptors();
+  // starts the HOG of the frame with the blocks of the objects, which must
+  // have been added; it is computed when first used
+  void startHog();
+
+  void addObject(ObjectProfile &obj);
+
+  /*
+  Estimated profile of the object, for OBJECT_MODE_FAST. If it cannot be
+  estimated the exact one is added: clustered from the bounding box if
+  candidates are its pixels (fromBox), else from the object's indices.
+   */
+  void addFastObject(vector<double> &feats, int id, string transformfile,
+                     const vector<int> &candidates, bool fromBox);
+
+  // compares obj with its estimate if this frame is validated
+  void validateObject(ObjectProfile &obj, vector<double> &feats,
+                      string transformfile, const vector<int> &candidates);
 
  public:
   static int FrameNum;
+  static ObjectMode objectMode;
+  // frames 1, 1 + VALIDATION_STRIDE, ... are validated
+  static const int VALIDATION_STRIDE = 10;
+  static ObjectModeStats objectModeStats;
+  // debug dumps of the frames, off until a sampling policy is set
+  static DebugWriter debugWriter;
+  // the RGBD features of the skeleton, kept from one frame to the next
+  static FeaturesSkelRGBD skeletonRgbdFeatures;
   int frameNum;
   string sequenceId;
   vector<ObjectProfile> objects;
@@ -170,8 +262,12 @@ class Frame {
 
   void printHOGFeats();
 
+  // queues the cloud to debugWriter if the frame is sampled
   void savePointCloud();
 
+  // same for the points of each object
+  void saveObjectPointClouds();
+
   void saveObjImage(ObjectProfile & obj, int ***IMAGE);
 
   void saveImage();
@@ -182,12 +278,27 @@ class Frame {
 
   Frame();
 
+  // exchanges the contents of the two frames without copying their clouds
+  void swap(Frame &other);
+
+  // copies what the segment features use into other: the ids, the skeleton
+  // and the objects, but not the cloud and the HOG
+  void copySegmentData(Frame &other) const;
+
+  // squared distance from every skeleton joint to the nearest point of
+  // every object, distances[joint][object]
+  void getJointObjectDistances(vector<vector<double> > &distances);
+
+  // the tracker, if any, must be passed every frame of the sequence
   Frame(int ***IMAGE, double** data, double **pos_data,
         vector<vector<double> > &objFeats, string seqId, int fnum,
-        string transformfile);
+        string transformfile, ObjectTracker *tracker = NULL);
 
+  // without a valid skeleton the body parts are skipped and rgbdskel_feats
+  // is left empty
   Frame(int ***IMAGE, double** data, double **pos_data,
-        vector<vector<double> > &objFeats, string seqId, int fnum);
+        vector<vector<double> > &objFeats, string seqId, int fnum,
+        ObjectTracker *tracker = NULL, bool skeletonTracked = true);
 
 
   Frame(int ***IMAGE, double** data, double **pos_data,
@@ -200,6 +311,9 @@ class Frame {
         string transformfile, vector<vector<int> > &objPCInds,
         bool partial = false);
 
+  // parses --object-mode=exact|fast|validate, false for any other option
+  static bool parseObjectMode(string option);
+
   ~Frame();
 };
 
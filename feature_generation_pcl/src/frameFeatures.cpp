@@ -27,6 +27,8 @@ class FrameFeatures {
 
   std::ofstream ofeatfile, sfeatfile, oofeatfile, sofeatfile;
   std::ofstream temporalSkelfeatfile, temporalObjfeatfile;
+  // the frames without a valid skeleton, whose skeleton features are zeros
+  std::ofstream untrackedfile;
 
   void print_feats(vector<vector<double> > &feats) {
     for (size_t i = 0; i < feats.size(); i++) {
@@ -48,16 +50,21 @@ class FrameFeatures {
   void computeSkelFeatures(bool normalize) {
     bool started = false;
     int numFeats = 0;
-    Frame frameNew = frames.back();
-    started = features_skeleton->extractSkeletonFeature(frameNew.skeleton.data,
-                                                        frameNew.skeleton.pos_data);
+    Frame &frameNew = frames.back();
+    if (!frameNew.skeleton.tracked) {
+      skel_features = FeaturesSkel::getDefaultFeatureValues();
+      return;
+    }
+    double *data[JOINT_NUM], *pos_data[POS_JOINT_NUM];
+    frameNew.skeleton.getRows(data, pos_data);
+    started = features_skeleton->extractSkeletonFeature(data, pos_data);
     if (started) {
       skel_features = features_skeleton->getFeatureValues();
     }
   }
 
   void computeObjFeatures(bool normalize) {
-    Frame frameNew = frames.back();
+    Frame &frameNew = frames.back();
     for (size_t i = 0; i < frameNew.objects.size(); i++) {
       obj_features.push_back(vector<double>(0));
     }
@@ -81,7 +88,7 @@ class FrameFeatures {
 
   void computeObjPairFeatures(bool normalize) {
     // for every frame compute the obj-obj pair features
-    Frame frameNew = frames.back();
+    Frame &frameNew = frames.back();
     for (size_t i = 0; i < frameNew.objects.size(); i++) {
       for (size_t j = 0; j < frameNew.objects.size(); j++) {
         if (i != j) {
@@ -97,10 +104,10 @@ class FrameFeatures {
                                         const ObjectProfile & obj) {
     vector<double> features;
     double dist = 0;
-    for (size_t i = 0; i < skel.transformed_joints.size(); i++) {
-      dist = pow((skel.transformed_joints.at(i).x - obj.centroid.x), 2);
-      dist += pow((skel.transformed_joints.at(i).y - obj.centroid.y), 2);
-      dist += pow((skel.transformed_joints.at(i).z - obj.centroid.z), 2);
+    for (int i = 0; i < skel.num_transformed_joints; i++) {
+      dist = pow((skel.transformed_joints[i].x - obj.centroid.x), 2);
+      dist += pow((skel.transformed_joints[i].y - obj.centroid.y), 2);
+      dist += pow((skel.transformed_joints[i].z - obj.centroid.z), 2);
       features.push_back(dist);
     }
     return features;
@@ -108,9 +115,13 @@ class FrameFeatures {
 
   void computeSkelObjPairFeatures(bool normalize) {
     // for every pair of objects compute the objObj features
-    Frame frameNew = frames.back();
+    Frame &frameNew = frames.back();
 
     for (size_t i = 0; i < frameNew.objects.size(); i++) {
+      if (!frameNew.skeleton.tracked) {
+        skel_obj_features.push_back(vector<double>(frameNew.skeleton.num_transformed_joints, 0.0));
+        continue;
+      }
       skel_obj_features.push_back(vector<double> (0));
       skel_obj_features.at(skel_obj_features.size() - 1) = computeSkelObjFeatures(frameNew.skeleton, frameNew.objects.at(i));
     }
@@ -118,8 +129,8 @@ class FrameFeatures {
 
   void computeObjTemporalFeatures(bool normalize) {
 
-    Frame frameNew = frames.back();
-    Frame frameOld = frames.front();
+    Frame &frameNew = frames.back();
+    Frame &frameOld = frames.front();
     for (size_t i = 0; i < frameNew.objects.size(); i++) {
       obj_temporal_features.push_back(vector<double>(0));
       obj_temporal_features.at(i).push_back(frameNew.objects.at(i).getXDispCentroids(frameOld.objects.at(i)));
@@ -135,14 +146,20 @@ class FrameFeatures {
   }
 
   void computeSkelTemporalFeatures(bool normalize) {
-    Frame frameNew = frames.back();
-    Frame frameOld = frames.front();
+    Frame &frameNew = frames.back();
+    Frame &frameOld = frames.front();
+    if (!frameNew.skeleton.tracked || !frameOld.skeleton.tracked) {
+      skel_temporal_features.assign(4 * (frameNew.skeleton.num_transformed_joints + frameNew.skeleton.num_local_joints), 0.0);
+      temporalSkelfeatfile << frameNew.sequenceId << "," << frameOld.frameNum << "," << frameNew.frameNum;
+      print_feats(skel_temporal_features, temporalSkelfeatfile);
+      return;
+    }
     // distance between of local joints positions
-    for (size_t i = 0; i < frameNew.skeleton.transformed_joints.size(); i++) {
-      skel_temporal_features.push_back(frameNew.skeleton.transformed_joints.at(i).x - frameOld.skeleton.transformed_joints.at(i).x );
-      skel_temporal_features.push_back(frameNew.skeleton.transformed_joints.at(i).y - frameOld.skeleton.transformed_joints.at(i).y);
-      skel_temporal_features.push_back(frameNew.skeleton.transformed_joints.at(i).z - frameOld.skeleton.transformed_joints.at(i).z);
-      double dist = pow((frameNew.skeleton.transformed_joints.at(i).x - frameOld.skeleton.transformed_joints.at(i).x), 2) + pow((frameNew.skeleton.transformed_joints.at(i).y - frameOld.skeleton.transformed_joints.at(i).y), 2) + pow((frameNew.skeleton.transformed_joints.at(i).z - frameOld.skeleton.transformed_joints.at(i).z), 2);
+    for (int i = 0; i < frameNew.skeleton.num_transformed_joints; i++) {
+      skel_temporal_features.push_back(frameNew.skeleton.transformed_joints[i].x - frameOld.skeleton.transformed_joints[i].x );
+      skel_temporal_features.push_back(frameNew.skeleton.transformed_joints[i].y - frameOld.skeleton.transformed_joints[i].y);
+      skel_temporal_features.push_back(frameNew.skeleton.transformed_joints[i].z - frameOld.skeleton.transformed_joints[i].z);
+      double dist = pow((frameNew.skeleton.transformed_joints[i].x - frameOld.skeleton.transformed_joints[i].x), 2) + pow((frameNew.skeleton.transformed_joints[i].y - frameOld.skeleton.transformed_joints[i].y), 2) + pow((frameNew.skeleton.transformed_joints[i].z - frameOld.skeleton.transformed_joints[i].z), 2);
       skel_temporal_features.push_back(dist);
     }
     for (size_t i = 0; i < frameNew.skeleton.num_local_joints; i++) {
@@ -157,7 +174,7 @@ class FrameFeatures {
   }
 
   void writeObjObjFeats() {
-    Frame frameNew = frames.back();
+    Frame &frameNew = frames.back();
     int numObjs = frameNew.objects.size();
     int objPairCount = 0;
     for (size_t i = 0; i < numObjs; i++) {
@@ -172,7 +189,7 @@ class FrameFeatures {
   }
 
   void writeSkelObjFeats() {
-    Frame frameNew = frames.back();
+    Frame &frameNew = frames.back();
     int numObjs = frameNew.objects.size();
     for (size_t i = 0; i < numObjs; i++) {
       sofeatfile << frameNew.sequenceId << "," << frameNew.frameNum << "," << frameNew.objects.at(i).objID;
@@ -181,13 +198,13 @@ class FrameFeatures {
   }
 
   void writeSkelFeats() {
-    Frame frameNew = frames.back();
+    Frame &frameNew = frames.back();
     sfeatfile << frameNew.sequenceId << "," << frameNew.frameNum;
     print_feats(skel_features, sfeatfile);
   }
 
   void writeObjFeats() {
-    Frame frameNew = frames.back();
+    Frame &frameNew = frames.back();
     int numObjs = frameNew.objects.size();
     for (size_t i = 0; i < numObjs; i++) {
       ofeatfile << frameNew.sequenceId << "," << frameNew.frameNum
@@ -217,6 +234,9 @@ class FrameFeatures {
     writeSkelFeats();
     writeObjObjFeats();
     writeSkelObjFeats();
+    if (!frames.back().skeleton.tracked) {
+      untrackedfile << frames.back().sequenceId << "," << frames.back().frameNum << endl;
+    }
   }
 
   void computeTemporalFreatures(bool normalize) {
@@ -230,9 +250,14 @@ class FrameFeatures {
     frameCount = 0;
   }
 
-  void setCurrentFrames(list<Frame> &f, int id) {
+  // takes over the contents of frame, keeping the last two frames
+  void addFrame(Frame &frame, int id) {
     frameCount++;
-    frames = f;
+    frames.push_back(Frame());
+    frames.back().swap(frame);
+    if (frames.size() > 2) {
+      frames.pop_front();
+    }
   }
 
   FrameFeatures(bool Temporal) {
@@ -244,6 +269,7 @@ class FrameFeatures {
     sfeatfile.open("data_skel_feats.txt", ios::app);
     oofeatfile.open("data_obj_obj_feats.txt", ios::app);
     sofeatfile.open("data_skel_obj_feats.txt", ios::app);
+    untrackedfile.open("data_skel_untracked.txt", ios::app);
     if (temporal) {
       temporalObjfeatfile.open("data_temporal_obj_feats.txt", ios::app);
       temporalSkelfeatfile.open("data_temporal_skel_feats.txt", ios::app);
@@ -256,6 +282,7 @@ class FrameFeatures {
     sfeatfile.close();
     oofeatfile.close();
     sofeatfile.close();
+    untrackedfile.close();
     if (temporal) {
       temporalSkelfeatfile.close();
       temporalObjfeatfile.close();
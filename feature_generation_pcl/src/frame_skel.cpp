@@ -4,19 +4,25 @@ Copyright (C) 2012 Hema Koppula
 
 #include "./frame_skel.h"
 
-double* FrameSkel::computeLocalLoc(double head_ori[9], double head_pos[3],
-                                   double hand_pos[3]) {
+void FrameSkel::computeLocalLoc(const double head_ori[9],
+                                const double head_pos[3],
+                                const double hand_pos[3], double rel_hand[3]) {
   double handx = hand_pos[0] - head_pos[0];
   double handy = hand_pos[1] - head_pos[1];
   double handz = hand_pos[2] - head_pos[2];
 
-  double* rel_hand = new double[3];
-
   rel_hand[0] = (head_ori[0]*handx + head_ori[3]*handy + head_ori[6]*handz);
   rel_hand[1] = (head_ori[1]*handx + head_ori[4]*handy + head_ori[7]*handz);
   rel_hand[2] = (head_ori[2]*handx + head_ori[5]*handy + head_ori[8]*handz);
+}
 
-  return rel_hand;
+void FrameSkel::getRows(double **dataRows, double **posDataRows) {
+  for (int i = 0; i < JOINT_NUM; i++) {
+    dataRows[i] = data[i];
+  }
+  for (int i = 0; i < POS_JOINT_NUM; i++) {
+    posDataRows[i] = pos_data[i];
+  }
 }
 
 void FrameSkel::computePosition() {
@@ -24,7 +30,6 @@ void FrameSkel::computePosition() {
   double right_hand_pos[3];
   double head_ori[9];
   double head_pos[3];
-  double *local_joint;
   double joint_pos[3];
 
   for (int i = 0; i < 9; i++) {
@@ -34,14 +39,11 @@ void FrameSkel::computePosition() {
     head_pos[i] = data[HEAD_JOINT_NUM][i+9];
   }
 
-  for (size_t i = 0; i < jointList.size(); i ++) {
-    for (int j=0; j < 3; j++) {
-      joint_pos[j] = data[jointList.at(i)][j+9];
-    }
-    local_joint = computeLocalLoc(head_ori, head_pos, joint_pos);
+  for (int i = 0; i < num_joints; i ++) {
     for (int j=0; j < 3; j++) {
-      joints_local[i][j] = local_joint[j];
+      joint_pos[j] = data[jointList[i]][j+9];
     }
+    computeLocalLoc(head_ori, head_pos, joint_pos, joints_local[i]);
   }
   for (int i=0; i < 3; i++) {
     left_hand_pos[i] = pos_data[POS_LEFT_HAND_NUM][i];
@@ -50,71 +52,57 @@ void FrameSkel::computePosition() {
     right_hand_pos[i] = pos_data[POS_RIGHT_HAND_NUM][i];
   }
 
-  local_joint = computeLocalLoc(head_ori, head_pos, left_hand_pos);
-  for (int j=0; j < 3; j++) {
-    joints_local[jointList.size()][j] = local_joint[j];
-  }
-  local_joint = computeLocalLoc(head_ori, head_pos, right_hand_pos);
-  for (int j=0; j < 3; j++) {
-    joints_local[jointList.size()+1][j] = local_joint[j];
-  }
+  computeLocalLoc(head_ori, head_pos, left_hand_pos, joints_local[num_joints]);
+  computeLocalLoc(head_ori, head_pos, right_hand_pos,
+                  joints_local[num_joints+1]);
   return;
 }
 
 void FrameSkel::transformJointPositions(string transformFile) {
   TransformG globalTransform;
   globalTransform = readTranform(transformFile);
-  for (size_t i = 0; i < jointList.size(); i++) {
-    pcl::PointXYZ pt;
-    pt.x = data[jointList.at(i)][9];
-    pt.y = data[jointList.at(i)][11];
-    pt.z = data[jointList.at(i)][10];
+  transformJointPositions(globalTransform);
+}
+
+void FrameSkel::transformJointPositions(TransformG &globalTransform) {
+  num_transformed_joints = 0;
+  for (int i = 0; i < num_joints; i++) {
+    pcl::PointXYZ &pt = transformed_joints[num_transformed_joints++];
+    pt.x = data[jointList[i]][9];
+    pt.y = data[jointList[i]][11];
+    pt.z = data[jointList[i]][10];
     globalTransform.transformPointInPlace(pt);
-    transformed_joints.push_back(pt);
   }
-  for (size_t i = 0; i < pos_jointList.size(); i++) {
-    pcl::PointXYZ pt;
-    pt.x = pos_data[pos_jointList.at(i)][0];
-    pt.y = pos_data[pos_jointList.at(i)][2];
-    pt.z = pos_data[pos_jointList.at(i)][1];
+  for (int i = 0; i < num_pos_joints; i++) {
+    pcl::PointXYZ &pt = transformed_joints[num_transformed_joints++];
+    pt.x = pos_data[pos_jointList[i]][0];
+    pt.y = pos_data[pos_jointList[i]][2];
+    pt.z = pos_data[pos_jointList[i]][1];
     globalTransform.transformPointInPlace(pt);
-    transformed_joints.push_back(pt);
   }
 }
 
 void FrameSkel::initialize_local_joints(bool partial){
-  jointList.push_back(HEAD_JOINT_NUM);
-  jointList.push_back(NECK_JOINT_NUM);
-  jointList.push_back(TORSO_JOINT_NUM);
-  jointList.push_back(LEFT_SHOULDER_JOINT_NUM);
+  num_joints = 0;
+  jointList[num_joints++] = HEAD_JOINT_NUM;
+  jointList[num_joints++] = NECK_JOINT_NUM;
+  jointList[num_joints++] = TORSO_JOINT_NUM;
+  jointList[num_joints++] = LEFT_SHOULDER_JOINT_NUM;
   if(!partial) {
-    jointList.push_back(LEFT_ELBOW_JOINT_NUM);
+    jointList[num_joints++] = LEFT_ELBOW_JOINT_NUM;
   }
-  jointList.push_back(RIGHT_SHOULDER_JOINT_NUM);
+  jointList[num_joints++] = RIGHT_SHOULDER_JOINT_NUM;
   if(!partial) {
-    jointList.push_back(RIGHT_ELBOW_JOINT_NUM);
-  }
-  pos_jointList.push_back(POS_LEFT_HAND_NUM);
-  pos_jointList.push_back(POS_RIGHT_HAND_NUM);
-  num_local_joints = jointList.size()+pos_jointList.size();
-  joints_local = new double*[num_local_joints];
-  for (int i = 0; i < num_local_joints; i ++) {
-    joints_local[i] = new double[3];
+    jointList[num_joints++] = RIGHT_ELBOW_JOINT_NUM;
   }
+  num_pos_joints = 0;
+  pos_jointList[num_pos_joints++] = POS_LEFT_HAND_NUM;
+  pos_jointList[num_pos_joints++] = POS_RIGHT_HAND_NUM;
+  num_local_joints = num_joints + num_pos_joints;
+  num_transformed_joints = 0;
 }
 
 void FrameSkel::initialize_data(double **data_, double **pos_data_) {
-  data = new double*[JOINT_NUM];
-  data_CONF = new int*[JOINT_NUM];
-  for (int i = 0; i < JOINT_NUM; i++) {
-    data[i] = new double[JOINT_DATA_NUM];
-    data_CONF[i] = new int[JOINT_DATA_TYPE_NUM];
-  }
-  pos_data = new double*[POS_JOINT_NUM];
-  pos_data_CONF = new int[POS_JOINT_NUM];
-  for (int i = 0; i < POS_JOINT_NUM; i++) {
-    pos_data[i] = new double[POS_JOINT_DATA_NUM];
-  }
   // store current data
   for (int i=0; i < JOINT_NUM; i++) {
     for (int j=0; j < JOINT_DATA_NUM; j++) {
@@ -126,6 +114,27 @@ void FrameSkel::initialize_data(double **data_, double **pos_data_) {
       pos_data[i][j] = pos_data_[i][j];
     }
   }
+  // tracked until told otherwise by setTracking
+  for (int i=0; i < JOINT_NUM; i++) {
+    data_CONF[i][0] = data_CONF[i][1] = 1;
+  }
+  for (int i=0; i < POS_JOINT_NUM; i++) {
+    pos_data_CONF[i] = 1;
+  }
+  tracked = true;
+}
+
+void FrameSkel::setTracking(int **data_CONF_, int *pos_data_CONF_,
+                            bool tracked_) {
+  for (int i=0; i < JOINT_NUM; i++) {
+    for (int j=0; j < JOINT_DATA_TYPE_NUM; j++) {
+      data_CONF[i][j] = data_CONF_[i][j];
+    }
+  }
+  for (int i=0; i < POS_JOINT_NUM; i++) {
+    pos_data_CONF[i] = pos_data_CONF_[i];
+  }
+  tracked = tracked_;
 }
 
 void FrameSkel::initialize_head_orientation() {
@@ -154,6 +163,12 @@ void FrameSkel::initialize(double **data_, double **pos_data_,
   transformJointPositions(transformFile);
 }
 
+void FrameSkel::initialize(double **data_, double **pos_data_,
+                           TransformG &globalTransform) {
+  initialize(data_, pos_data_);
+  transformJointPositions(globalTransform);
+}
+
 void FrameSkel::initialize_partial(double **data_, double **pos_data_,
                                    string transformFile) {
   initialize_local_joints(true);
@@ -16,12 +16,18 @@ Copyright (C) 2012 Hema Koppula
 
 typedef pcl::PointXYZRGB PointT;
 
+/*
+The skeleton of one frame. All of it is stored inline in fixed size arrays,
+so frames are copied with a plain memory copy and nothing is allocated.
+ */
 class FrameSkel {
  private:
   void computePosition();
 
   void transformJointPositions(string transformFile);
 
+  void transformJointPositions(TransformG &globalTransform);
+
   void initialize_local_joints(bool partial);
 
   void initialize_data(double **data_, double **pos_data_);
@@ -29,38 +35,64 @@ class FrameSkel {
   void initialize_head_orientation();
 
  public:
-  double **data;  // [JOINT_NUM][JOINT_DATA_NUM];
-  int **data_CONF;  // [JOINT_NUM][JOINT_DATA_TYPE_NUM]
-  double **pos_data;  // [POS_JOINT_NUM][POS_JOINT_DATA_NUM];
-  int *pos_data_CONF;  // [POS_JOINT_NUM]
+  // the joints of jointList and pos_jointList
+  static const int MAX_LOCAL_JOINTS = 7 + 2;
+
+  double data[JOINT_NUM][JOINT_DATA_NUM];
+  int data_CONF[JOINT_NUM][JOINT_DATA_TYPE_NUM];
+  double pos_data[POS_JOINT_NUM][POS_JOINT_DATA_NUM];
+  int pos_data_CONF[POS_JOINT_NUM];
+  // false if the frame has no valid skeleton, see SkeletonImputer
+  bool tracked;
   int num_local_joints;
-  vector<pcl::PointXYZ> transformed_joints;
+  // jointList then pos_jointList, once transformJointPositions has run
+  pcl::PointXYZ transformed_joints[MAX_LOCAL_JOINTS];
+  int num_transformed_joints;
   pcl::PointXYZ headOrientation;
 
-  double ** joints_local;
-  vector<int> jointList;
-  vector<int> pos_jointList;
+  double joints_local[MAX_LOCAL_JOINTS][3];
+  int jointList[MAX_LOCAL_JOINTS];
+  int num_joints;
+  int pos_jointList[MAX_LOCAL_JOINTS];
+  int num_pos_joints;
   int frameId;
 
-  double* computeLocalLoc(double head_ori[9], double head_pos[3],
-                          double hand_pos[3]);
+  static void computeLocalLoc(const double head_ori[9],
+                              const double head_pos[3],
+                              const double hand_pos[3], double rel_hand[3]);
+
+  // row pointers into data and pos_data, for the code taking double **
+  void getRows(double **dataRows, double **posDataRows);
 
   void initialize(double **data_, double **pos_data_, string transformFile);
 
+  // the same with the transform already read, for many frames of a sequence
+  void initialize(double **data_, double **pos_data_,
+                  TransformG &globalTransform);
+
   void initialize_partial(double **data_, double **pos_data_,
                           string transformFile);
 
   void initialize(double **data_, double **pos_data_);
 
+  /*
+  Keeps the confidences the frame was read with, 0 for an untracked value.
+  The initializers take every value as tracked.
+   */
+  void setTracking(int **data_CONF_, int *pos_data_CONF_, bool tracked_);
+
   FrameSkel(double **data_, double **pos_data_, string transformFile);
 
   FrameSkel(double **data_, double **pos_data_);
 
   FrameSkel(double **data_, double **pos_data_, string transformFile, int fid);
 
-  FrameSkel() {}
-
-  ~FrameSkel() {}
+  FrameSkel()
+      : tracked(true),
+        num_local_joints(0),
+        num_transformed_joints(0),
+        num_joints(0),
+        num_pos_joints(0) {}
 };
 
 #endif  // FEATURE_GENERATION_PCL_SRC_FRAME_SKEL_H_
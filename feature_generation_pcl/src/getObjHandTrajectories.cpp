@@ -42,6 +42,9 @@ bool useImage = true;
 bool useDepth = true;
 bool useSkeleton = true;
 
+// also write the distance from every joint to every object
+bool writeDistances = false;
+
 
 
 map<string, string> data_act_map;
@@ -76,6 +79,19 @@ void getHandObjTraj(Frame &frame, std::ofstream &ofile, std::ofstream &hfile) {
   }
 }
 
+void getJointObjDistances(Frame &frame, std::ofstream &dfile) {
+  vector<vector<double> > distances;
+  frame.getJointObjectDistances(distances);
+  for (size_t i = 0; i < frame.objects.size(); i++) {
+    dfile << frame.sequenceId << "," << frame.frameNum << ","
+          << frame.objects.at(i).objID;
+    for (size_t j = 0; j < distances.size(); j++) {
+      dfile << "," << distances[j][i];
+    }
+    dfile << endl;
+  }
+}
+
 // print error message
 
 void errorMsg(string message) {
@@ -270,13 +286,28 @@ int main(int argc, char** argv) {
   dataLocation = (string) argv[1] + "/";
   string actfile = (string) argv[2];
   string mirrored_dataLocation = "";
+  ObjectTracker objectTracker;
+  for (int a = 3; a < argc; a++) {
+    string option = (string) argv[a];
+    if (option.compare("distances") == 0) {
+      writeDistances = true;
+    } else if (!objectTracker.parseOption(option) &&
+               !Frame::parseObjectMode(option) &&
+               !HOG::parseKernelOption(option)) {
+      Frame::debugWriter.parseOption(option);
+    }
+  }
 
   readDataActMap(actfile);
 
   std::ofstream ofile;
   std::ofstream hfile;
+  std::ofstream dfile;
   ofile.open("object_trajectories.txt", ios::app);
   hfile.open("hand_trajectories.txt", ios::app);
+  if (writeDistances) {
+    dfile.open("joint_object_distances.txt", ios::app);
+  }
 
   // get all names of file from the map
   vector<string> all_files;
@@ -347,9 +378,22 @@ int main(int argc, char** argv) {
                                        IMAGE, objData, objPCInds);
       int oldSegNum = 1;
       while (status > 0) {
-        Frame frame(IMAGE, data, pos_data, objData, all_files[i], status,
-                    transformfile, objPCInds);
+        Frame frame;
+        if (objectTracker.enabled()) {
+          // the objects are clustered from their boxes, following their
+          // clusters of the previous frame
+          Frame tracked(IMAGE, data, pos_data, objData, all_files[i], status,
+                        transformfile, &objectTracker);
+          frame.swap(tracked);
+        } else {
+          Frame extracted(IMAGE, data, pos_data, objData, all_files[i],
+                          status, transformfile, objPCInds);
+          frame.swap(extracted);
+        }
         getHandObjTraj(frame, ofile, hfile);
+        if (writeDistances) {
+          getJointObjDistances(frame, dfile);
+        }
         status = DATA->readNextFrame(data, pos_data, data_CONF, pos_data_CONF,
                                      IMAGE, objData, objPCInds);
         count++;
@@ -359,6 +403,16 @@ int main(int argc, char** argv) {
   // fclose(pRecFile);
   ofile.close();
   hfile.close();
+  if (writeDistances) {
+    dfile.close();
+  }
+  if (Frame::objectMode == OBJECT_MODE_VALIDATE) {
+    Frame::objectModeStats.print(cout);
+  }
+  if (objectTracker.enabled()) {
+    objectTracker.print(cout);
+  }
+  Frame::debugWriter.flush();
   printf("ALL DONE.\n\n");
 
   return 0;
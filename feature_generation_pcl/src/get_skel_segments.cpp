@@ -111,10 +111,41 @@ void readDataActMapOld() {
   printf("\tcount = %d\n\n", count);
 }
 
+// the comma separated elements of list
+vector<string> splitList(const string &list) {
+  vector<string> elements;
+  stringstream lineStream(list);
+  string element;
+  while (getline(lineStream, element, ',')) {
+    elements.push_back(element);
+  }
+  return elements;
+}
+
 int main(int argc, char **argv) {
   srand(time(0));
-  int method = atoi(argv[3]);
-  float threshold = atof(argv[4]);
+  // several methods or thresholds make a sweep, see computeSegmentsSweep
+  vector<string> methodArgs = splitList(argv[3]);
+  vector<string> thresholdArgs = splitList(argv[4]);
+  vector<int> methods;
+  vector<float> thresholds;
+  for (size_t i = 0; i < methodArgs.size(); i++) {
+    methods.push_back(atoi(methodArgs[i].c_str()));
+  }
+  for (size_t i = 0; i < thresholdArgs.size(); i++) {
+    thresholds.push_back(atof(thresholdArgs[i].c_str()));
+  }
+  if (methods.empty() || thresholds.empty()) {
+    errorMsg("no method or threshold given.");
+  }
+  bool sweep = (methods.size() > 1 || thresholds.size() > 1);
+  int method = methods[0];
+  float threshold = thresholds[0];
+  // segments each frame as it is read instead of after the whole activity
+  bool online = (argc > 5 && string(argv[5]).compare("online") == 0);
+  if (sweep && online) {
+    errorMsg("the online segmentation takes a single method and threshold.");
+  }
   dataLocation = argv[1];
   string actfile = (string) argv[2];
   readDataActMap(actfile);
@@ -150,13 +181,36 @@ int main(int argc, char **argv) {
     }
   }
 
-  segmentfile.open("Segmentation.txt",ios::app);
+  // one file per method and threshold of a sweep
+  vector<std::ofstream *> sweepFiles;
+  if (sweep) {
+    for (size_t i = 0; i < methods.size(); i++) {
+      for (size_t j = 0; j < thresholds.size(); j++) {
+        string name = "Segmentation_" + methodArgs[i] + "_" + thresholdArgs[j]
+                      + ".txt";
+        sweepFiles.push_back(new std::ofstream(name.c_str(), ios::app));
+      }
+    }
+  } else {
+    segmentfile.open("Segmentation.txt",ios::app);
+  }
   for (size_t i = 0; i < all_files.size(); i++) {
     int count = 1;
-    readData* DATA = new readData(dataLocation, all_files.at(i));
+    // the skeleton file alone, the RGBD file is not read
+    readData* DATA = new readData(dataLocation, all_files.at(i), false);
     Segmentation_skel segSkel;
     int status = 1;
     string transformfile = dataLocation+ all_files.at(i) + "_globalTransform.txt";
+    if (online) {
+      segmentfile << all_files.at(i) << ";";
+      segSkel.startStream(threshold, method, segmentfile);
+      while ((status = DATA->readNextFrame(data, pos_data, data_CONF,
+                                           pos_data_CONF)) > 0) {
+        segSkel.addStreamFrame(data, pos_data, transformfile);
+      }
+      segSkel.finishStream();
+      continue;
+    }
     do {
       status = DATA->readNextFrame(data, pos_data, data_CONF, pos_data_CONF);
       if (status != 0)
@@ -164,10 +218,22 @@ int main(int argc, char **argv) {
         cout << "status = " << status << endl;
     } while (status > 0);
 
+    if (sweep) {
+      segSkel.computeSegmentsSweep(methods, thresholds);
+      for (size_t k = 0; k < sweepFiles.size(); k++) {
+        *sweepFiles[k] << all_files.at(i) << ";";
+        segSkel.printSweepSegments(*sweepFiles[k], k);
+      }
+      continue;
+    }
     segSkel.computeSegmentsDynamic(threshold,method);
     segmentfile << all_files.at(i) << ";";
     segSkel.printSegments(segmentfile);
 
   }
+  for (size_t k = 0; k < sweepFiles.size(); k++) {
+    sweepFiles[k]->close();
+    delete sweepFiles[k];
+  }
   segmentfile.close();
 }
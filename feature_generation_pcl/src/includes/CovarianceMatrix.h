@@ -8,6 +8,9 @@ Copyright (C) 2012 Hema Koppula
 #include <Eigen/Core>
 #include <Eigen/QR>
 #include <Eigen/Eigenvalues>
+#include <Eigen/Geometry>
+#include <math.h>
+#include <vector>
 
 inline void computeCentroid(const pcl::PointCloud<pcl::PointXYZRGB> &points,
                              pcl::PointXYZ &centroid) {
@@ -23,39 +26,180 @@ inline void computeCentroid(const pcl::PointCloud<pcl::PointXYZRGB> &points,
 }
 
 
+/*
+Single pass accumulation of the centroid and the scatter (sum of outer
+products about the centroid) of a set of points. The sums are taken about
+the first point added and in double precision, so that the result does not
+suffer from cancellation when the points are far from the origin.
+ */
+class MomentAccumulator {
+ public:
+  MomentAccumulator() : n_(0) {
+    for (int k = 0; k < 3; k++)
+      shift_[k] = sum_[k] = 0;
+    for (int k = 0; k < 6; k++)
+      sumSq_[k] = 0;
+  }
+
+  void add(double x, double y, double z) {
+    if (n_ == 0) {
+      shift_[0] = x;
+      shift_[1] = y;
+      shift_[2] = z;
+    }
+    double dx = x - shift_[0], dy = y - shift_[1], dz = z - shift_[2];
+    sum_[0] += dx;
+    sum_[1] += dy;
+    sum_[2] += dz;
+    sumSq_[0] += dx * dx;
+    sumSq_[1] += dx * dy;
+    sumSq_[2] += dx * dz;
+    sumSq_[3] += dy * dy;
+    sumSq_[4] += dy * dz;
+    sumSq_[5] += dz * dz;
+    n_++;
+  }
+
+  int size() const { return n_; }
+
+  void getCentroid(pcl::PointXYZ &centroid) const {
+    centroid.x = shift_[0] + sum_[0] / n_;
+    centroid.y = shift_[1] + sum_[1] / n_;
+    centroid.z = shift_[2] + sum_[2] / n_;
+  }
+
+  // sum of the outer products about the centroid, not divided by the size
+  void getScatter(Eigen::Matrix3d &scatter) const {
+    scatter(0, 0) = sumSq_[0] - sum_[0] * sum_[0] / n_;
+    scatter(0, 1) = sumSq_[1] - sum_[0] * sum_[1] / n_;
+    scatter(0, 2) = sumSq_[2] - sum_[0] * sum_[2] / n_;
+    scatter(1, 1) = sumSq_[3] - sum_[1] * sum_[1] / n_;
+    scatter(1, 2) = sumSq_[4] - sum_[1] * sum_[2] / n_;
+    scatter(2, 2) = sumSq_[5] - sum_[2] * sum_[2] / n_;
+    scatter(1, 0) = scatter(0, 1);
+    scatter(2, 0) = scatter(0, 2);
+    scatter(2, 1) = scatter(1, 2);
+  }
+
+ private:
+  int n_;
+  double shift_[3];
+  double sum_[3];
+  double sumSq_[6];
+};
+
 inline void computeCovarianceMatrix(
     const pcl::PointCloud<pcl::PointXYZRGB> &points,
     Eigen::Matrix3d &covariance_matrix, pcl::PointXYZ &centroid) {
+  MomentAccumulator moments;
+  for (unsigned int j = 0; j < points.points.size(); j++)
+    moments.add(points.points[j].x, points.points[j].y, points.points[j].z);
+  moments.getCentroid(centroid);
+  moments.getScatter(covariance_matrix);
+}
 
-  computeCentroid(points, centroid);
-
-  // Initialize to 0
-  covariance_matrix = Eigen::Matrix3d::Zero();
-
-  // Sum of outer products
-  // covariance_matrix (k, i)  += points_c (j, k) * points_c (j, i);
-  for (unsigned int j = 0; j < points.points.size(); j++) {
-    covariance_matrix(0, 0) += (points.points[j].x - centroid.x)
-                               * (points.points[j].x - centroid.x);
-    covariance_matrix(0, 1) += (points.points[j].x - centroid.x)
-                               * (points.points[j].y - centroid.y);
-    covariance_matrix(0, 2) += (points.points[j].x - centroid.x)
-                               * (points.points[j].z - centroid.z);
-
-    covariance_matrix(1, 0) += (points.points[j].y - centroid.y)
-                               * (points.points[j].x - centroid.x);
-    covariance_matrix(1, 1) += (points.points[j].y - centroid.y)
-                               * (points.points[j].y - centroid.y);
-    covariance_matrix(1, 2) += (points.points[j].y - centroid.y)
-                               * (points.points[j].z - centroid.z);
-
-    covariance_matrix(2, 0) += (points.points[j].z - centroid.z)
-                               * (points.points[j].x - centroid.x);
-    covariance_matrix(2, 1) += (points.points[j].z - centroid.z)
-                               * (points.points[j].y - centroid.y);
-    covariance_matrix(2, 2) += (points.points[j].z - centroid.z)
-                               * (points.points[j].z - centroid.z);
+inline void computeCovarianceMatrix(
+    const pcl::PointCloud<pcl::PointXYZRGB> &points,
+    const std::vector<int> &indices,
+    Eigen::Matrix3d &covariance_matrix, pcl::PointXYZ &centroid) {
+  MomentAccumulator moments;
+  for (size_t j = 0; j < indices.size(); j++) {
+    const pcl::PointXYZRGB &p = points.points[indices[j]];
+    moments.add(p.x, p.y, p.z);
+  }
+  moments.getCentroid(centroid);
+  moments.getScatter(covariance_matrix);
+}
+
+/*
+Unit vector orthogonal to the rows of the rank deficient matrix m, taken
+from the largest cross product of two of its rows. Returns false if no
+pair of rows spans a plane (m has rank < 2).
+ */
+inline bool getNullVector(const Eigen::Matrix3d &m, Eigen::Vector3d &v) {
+  Eigen::Vector3d c[3] = {m.row(0).cross(m.row(1)),
+                          m.row(0).cross(m.row(2)),
+                          m.row(1).cross(m.row(2))};
+  int best = 0;
+  for (int k = 1; k < 3; k++) {
+    if (c[k].squaredNorm() > c[best].squaredNorm())
+      best = k;
+  }
+  double norm = c[best].norm();
+  if (!(norm > 1e-12 * (m.squaredNorm() + 1e-300)))
+    return false;
+  v = c[best] / norm;
+  return true;
+}
+
+/*
+Closed form eigen decomposition of a symmetric 3x3 matrix. Eigenvalues are
+sorted in increasing order and the eigenvectors are the matching columns,
+as returned by Eigen::SelfAdjointEigenSolver.
+ */
+inline void computeEigen3x3(const Eigen::Matrix3d &matrix,
+                            Eigen::Vector3d &values, Eigen::Matrix3d &vectors) {
+  // scale to avoid over and underflow
+  double scale = matrix.cwiseAbs().maxCoeff();
+  if (scale == 0) {
+    values.setZero();
+    vectors.setIdentity();
+    return;
+  }
+  Eigen::Matrix3d a = matrix / scale;
+  double offDiag = a(0, 1) * a(0, 1) + a(0, 2) * a(0, 2) + a(1, 2) * a(1, 2);
+  double q = a.trace() / 3;
+  double p2 = (a(0, 0) - q) * (a(0, 0) - q) + (a(1, 1) - q) * (a(1, 1) - q)
+              + (a(2, 2) - q) * (a(2, 2) - q) + 2 * offDiag;
+  double p = sqrt(p2 / 6);
+  if (p < 1e-15) {
+    // a multiple of the identity
+    values.setConstant(q * scale);
+    vectors.setIdentity();
+    return;
+  }
+  // eigenvalues of b = (a - q I) / p are 2 cos(phi + 2 k pi / 3)
+  Eigen::Matrix3d b = (a - q * Eigen::Matrix3d::Identity()) / p;
+  double r = b.determinant() / 2;
+  r = r < -1 ? -1 : (r > 1 ? 1 : r);
+  double phi = acos(r) / 3;
+  double largest = q + 2 * p * cos(phi);
+  double smallest = q + 2 * p * cos(phi + 2 * M_PI / 3);
+  double middle = 3 * q - largest - smallest;
+  values << smallest, middle, largest;
+
+  // the eigenvector of the most isolated eigenvalue is the best conditioned,
+  // the other two are solved for in the plane orthogonal to it
+  bool smallestFirst = (middle - smallest) >= (largest - middle);
+  double isolated = smallestFirst ? smallest : largest;
+  Eigen::Vector3d first;
+  if (!getNullVector(a - isolated * Eigen::Matrix3d::Identity(), first)) {
+    values *= scale;
+    vectors.setIdentity();
+    return;
+  }
+  Eigen::Vector3d u = first.unitOrthogonal();
+  Eigen::Vector3d w = first.cross(u);
+  double m00 = u.dot(a * u);
+  double m01 = u.dot(a * w);
+  double m11 = w.dot(a * w);
+  double theta = 0.5 * atan2(2 * m01, m00 - m11);
+  Eigen::Vector3d upper = cos(theta) * u + sin(theta) * w;
+  Eigen::Vector3d lower = -sin(theta) * u + cos(theta) * w;
+  double mean = (m00 + m11) / 2;
+  double radius = sqrt((m00 - m11) * (m00 - m11) / 4 + m01 * m01);
+  if (smallestFirst) {
+    values << isolated, mean - radius, mean + radius;
+    vectors.col(0) = first;
+    vectors.col(1) = lower;
+    vectors.col(2) = upper;
+  } else {
+    values << mean - radius, mean + radius, isolated;
+    vectors.col(0) = lower;
+    vectors.col(1) = upper;
+    vectors.col(2) = first;
   }
+  values *= scale;
 }
 
 #endif  // FEATURE_GENERATION_PCL_SRC_INCLUDES_COVARIANCEMATRIX_H_
@@ -0,0 +1,232 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_OBJECTTRACKER_H_
+#define FEATURE_GENERATION_PCL_SRC_OBJECTTRACKER_H_
+
+#include <math.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <pcl/point_types.h>
+
+#include "constants.h"
+#include "pixel_mask.h"
+
+/*
+Carries the cluster of each object from one frame of a sequence to the next,
+so that objects which barely moved are not clustered again. The previous
+cluster is checked pixel by pixel against the new point cloud: its pixels
+which are still candidates of the object and whose points moved less than
+the clustering radius are kept. If enough of them are, the cluster is grown
+from them over the neighbouring candidate pixels, so only the changed border
+is clustered. Otherwise the caller falls back to the full clustering.
+
+The radius is the one of getClusters: tolerance times the distance of the
+point, as set by convert in pointcloudClustering.h. The growth only follows
+neighbouring pixels, so points which the full clustering joins across a gap
+of non-candidate pixels are missed. With validation on, the caller also runs
+the full clustering on the tracked objects and the differences are counted.
+ */
+class ObjectTracker {
+ public:
+  // tolerance is the one passed by getClusters to the clustering
+  ObjectTracker(float tolerance = 0.05, float minStableFraction = 0.8,
+                float maxGrowth = 1.5)
+      : tolerance_(tolerance),
+        minStableFraction_(minStableFraction),
+        maxGrowth_(maxGrowth),
+        enabled_(false),
+        validation_(false),
+        numTracked_(0),
+        numClustered_(0),
+        numValidated_(0),
+        numMismatched_(0),
+        numDifferentPoints_(0),
+        numPoints_(0),
+        candidateMask_(X_RES, Y_RES),
+        clusterMask_(X_RES, Y_RES) {}
+
+  // parses --track-objects[=validate], false for any other option
+  bool parseOption(const std::string &option) {
+    if (option.compare("--track-objects") == 0) {
+      enabled_ = true;
+    } else if (option.compare("--track-objects=validate") == 0) {
+      enabled_ = true;
+      validation_ = true;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  // whether the driver asked for tracking
+  bool enabled() const { return enabled_; }
+
+  void setValidation(bool validation) { validation_ = validation; }
+
+  bool validating() const { return validation_; }
+
+  void reset() {
+    tracks_.clear();
+  }
+
+  // forgets the tracks when the sequence changes
+  void startFrame(const std::string &sequenceId) {
+    if (sequenceId.compare(sequenceId_) != 0) {
+      reset();
+      sequenceId_ = sequenceId;
+    }
+  }
+
+  /*
+  Derives the cluster of the object from its previous one. candidates are
+  the sorted indices of the cloud points which may belong to the object and
+  the cluster is returned in increasing order. Returns false if there is no
+  previous cluster or it does not match the new points.
+   */
+  bool trackObject(int objID, const pcl::PointCloud<PointT> &fullCloud,
+                   const std::vector<int> &candidates,
+                   std::vector<int> &cluster) {
+    std::map<int, Track>::iterator it = tracks_.find(objID);
+    if (it == tracks_.end() || it->second.indices.empty()) {
+      numClustered_++;
+      return false;
+    }
+    const Track &track = it->second;
+
+    candidateMask_.clear();
+    candidateMask_.set(candidates);
+    clusterMask_.clear();
+    std::vector<int> frontier;
+    for (size_t k = 0; k < track.indices.size(); k++) {
+      int index = track.indices[k];
+      if (candidateMask_.test(index) &&
+          sqrDistance(fullCloud.points[index], track.points[k]) <=
+          sqrRadius(track.points[k])) {
+        clusterMask_.set(index);
+        frontier.push_back(index);
+      }
+    }
+    if (frontier.size() < minStableFraction_ * track.indices.size()) {
+      numClustered_++;
+      return false;
+    }
+
+    // grow over the 8-neighbourhood of the kept pixels
+    while (!frontier.empty()) {
+      int index = frontier.back();
+      frontier.pop_back();
+      float radius2 = sqrRadius(fullCloud.points[index]);
+      int x = index % X_RES, y = index / X_RES;
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          int nx = x + dx, ny = y + dy;
+          if (nx < 0 || nx >= X_RES || ny < 0 || ny >= Y_RES)
+            continue;
+          int neighbour = ny * X_RES + nx;
+          if (!candidateMask_.test(neighbour) || clusterMask_.test(neighbour))
+            continue;
+          if (sqrDistance(fullCloud.points[index],
+                          fullCloud.points[neighbour]) <= radius2) {
+            clusterMask_.set(neighbour);
+            frontier.push_back(neighbour);
+          }
+        }
+      }
+    }
+
+    cluster.clear();
+    for (size_t i = 0; i < candidates.size(); i++) {
+      if (clusterMask_.test(candidates[i]))
+        cluster.push_back(candidates[i]);
+    }
+    // the object merged with something else, cluster it again
+    if (cluster.size() > maxGrowth_ * track.indices.size()) {
+      numClustered_++;
+      return false;
+    }
+    numTracked_++;
+    return true;
+  }
+
+  // compares a tracked cluster with the one of the full clustering, both
+  // in increasing order
+  void addValidation(const std::vector<int> &tracked,
+                     const std::vector<int> &clustered) {
+    std::vector<int> difference;
+    std::set_symmetric_difference(tracked.begin(), tracked.end(),
+                                  clustered.begin(), clustered.end(),
+                                  std::back_inserter(difference));
+    numValidated_++;
+    if (!difference.empty())
+      numMismatched_++;
+    numDifferentPoints_ += difference.size();
+    numPoints_ += clustered.size();
+  }
+
+  void print(std::ostream &out) const {
+    out << "object tracking: " << numTracked_ << " objects tracked, "
+        << numClustered_ << " clustered" << std::endl;
+    if (validation_) {
+      out << "  " << numValidated_ << " tracked objects validated, "
+          << numMismatched_ << " differ from the full clustering, in "
+          << numDifferentPoints_ << " of " << numPoints_ << " points"
+          << std::endl;
+    }
+  }
+
+  // remembers the cluster of the object for the next frame
+  void setCluster(int objID, const pcl::PointCloud<PointT> &fullCloud,
+                  const std::vector<int> &cluster) {
+    Track &track = tracks_[objID];
+    track.indices = cluster;
+    track.points.resize(cluster.size());
+    for (size_t k = 0; k < cluster.size(); k++)
+      track.points[k] = fullCloud.points[cluster[k]];
+  }
+
+ private:
+  struct Track {
+    std::vector<int> indices;
+    std::vector<PointT, Eigen::aligned_allocator<PointT> > points;
+  };
+
+  float tolerance_;
+  float minStableFraction_;
+  float maxGrowth_;
+  bool enabled_;
+  bool validation_;
+  long numTracked_;
+  long numClustered_;
+  long numValidated_;
+  long numMismatched_;
+  long numDifferentPoints_;
+  long numPoints_;
+  std::string sequenceId_;
+  std::map<int, Track> tracks_;
+  // scratch masks over the whole image
+  PixelMask candidateMask_;
+  PixelMask clusterMask_;
+
+  static float sqrDistance(const PointT &a, const PointT &b) {
+    return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) +
+           (a.z - b.z) * (a.z - b.z);
+  }
+
+  // squared clustering radius at p, from the same distance as convert
+  // (which adds z instead of its square)
+  float sqrRadius(const PointT &p) const {
+    float distance = sqrt(p.x * p.x + p.y * p.y + p.z + p.z);
+    float radius = tolerance_ * distance;
+    return radius * radius;
+  }
+};
+
+#endif  // FEATURE_GENERATION_PCL_SRC_OBJECTTRACKER_H_
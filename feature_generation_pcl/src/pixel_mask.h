@@ -0,0 +1,217 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_PIXEL_MASK_H_
+#define FEATURE_GENERATION_PCL_SRC_PIXEL_MASK_H_
+
+#include <stdint.h>
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+
+// One bit per pixel of a width x height image, stored row major so that bit
+// y * width + x is pixel (x, y), i.e. the index of that pixel in the
+// organized point cloud. All set operations and scans work on 64 pixels at a
+// time.
+class PixelMask {
+ public:
+  PixelMask() : width_(0), height_(0) {}
+
+  PixelMask(int width, int height) {
+    resize(width, height);
+  }
+
+  // resizes the mask and clears all the pixels
+  void resize(int width, int height) {
+    width_ = width;
+    height_ = height;
+    words_.assign((size() + 63) / 64, 0);
+  }
+
+  void clear() {
+    words_.assign(words_.size(), 0);
+  }
+
+  void swap(PixelMask &other) {
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    words_.swap(other.words_);
+  }
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int size() const { return width_ * height_; }
+
+  void set(int index) {
+    words_[index >> 6] |= bit(index);
+  }
+
+  void reset(int index) {
+    words_[index >> 6] &= ~bit(index);
+  }
+
+  bool test(int index) const {
+    return (words_[index >> 6] & bit(index)) != 0;
+  }
+
+  // sets the bits [begin, end)
+  void setRange(int begin, int end) {
+    clip(begin, end);
+    for (int w = begin >> 6; begin < end && w <= (end - 1) >> 6; w++)
+      words_[w] |= rangeBits(w, begin, end);
+  }
+
+  // sets the pixels of the box, bounds inclusive
+  void setBox(int minX, int minY, int maxX, int maxY) {
+    for (int y = minY; y <= maxY; y++)
+      setRange(y * width_ + minX, y * width_ + maxX + 1);
+  }
+
+  void set(const std::vector<int> &indices) {
+    for (size_t i = 0; i < indices.size(); i++)
+      set(indices[i]);
+  }
+
+  void unionWith(const PixelMask &other) {
+    assert(other.words_.size() == words_.size());
+    for (size_t w = 0; w < words_.size(); w++)
+      words_[w] |= other.words_[w];
+  }
+
+  void intersectWith(const PixelMask &other) {
+    assert(other.words_.size() == words_.size());
+    for (size_t w = 0; w < words_.size(); w++)
+      words_[w] &= other.words_[w];
+  }
+
+  // clears every pixel which is set in other
+  void subtract(const PixelMask &other) {
+    assert(other.words_.size() == words_.size());
+    for (size_t w = 0; w < words_.size(); w++)
+      words_[w] &= ~other.words_[w];
+  }
+
+  int count() const {
+    int total = 0;
+    for (size_t w = 0; w < words_.size(); w++)
+      total += __builtin_popcountll(words_[w]);
+    return total;
+  }
+
+  // number of set pixels in the bits [begin, end)
+  int countInRange(int begin, int end) const {
+    clip(begin, end);
+    int total = 0;
+    for (int w = begin >> 6; begin < end && w <= (end - 1) >> 6; w++)
+      total += __builtin_popcountll(words_[w] & rangeBits(w, begin, end));
+    return total;
+  }
+
+  // number of set pixels in the box, bounds inclusive
+  int countInBox(int minX, int minY, int maxX, int maxY) const {
+    int total = 0;
+    for (int y = minY; y <= maxY; y++)
+      total += countInRange(y * width_ + minX, y * width_ + maxX + 1);
+    return total;
+  }
+
+  // appends, in increasing order, the indices of the bits in [begin, end)
+  // which equal value
+  void getIndicesInRange(int begin, int end, bool value,
+                         std::vector<int> &indices) const {
+    clip(begin, end);
+    for (int w = begin >> 6; begin < end && w <= (end - 1) >> 6; w++) {
+      uint64_t bits = value ? words_[w] : ~words_[w];
+      bits &= rangeBits(w, begin, end);
+      while (bits) {
+        indices.push_back((w << 6) + __builtin_ctzll(bits));
+        bits &= bits - 1;
+      }
+    }
+  }
+
+  // appends, row by row, the indices of the pixels in the box which equal
+  // value; bounds inclusive
+  void getIndicesInBox(int minX, int minY, int maxX, int maxY, bool value,
+                       std::vector<int> &indices) const {
+    for (int y = minY; y <= maxY; y++)
+      getIndicesInRange(y * width_ + minX, y * width_ + maxX + 1, value,
+                        indices);
+  }
+
+  void getIndices(std::vector<int> &indices) const {
+    getIndicesInRange(0, size(), true, indices);
+  }
+
+  // copies the box into a mask of its own size, so that bit
+  // (y - minY) * (maxX - minX + 1) + (x - minX) of the result is pixel (x, y)
+  PixelMask extractBox(int minX, int minY, int maxX, int maxY) const {
+    int boxWidth = maxX - minX + 1;
+    PixelMask box(boxWidth, maxY - minY + 1);
+    for (int y = minY; y <= maxY; y++) {
+      int src = y * width_ + minX;
+      int dst = (y - minY) * boxWidth;
+      for (int x = 0; x < boxWidth; x += 64) {
+        int n = boxWidth - x < 64 ? boxWidth - x : 64;
+        box.setBits(dst + x, n, getBits(src + x, n));
+      }
+    }
+    return box;
+  }
+
+ private:
+  int width_;
+  int height_;
+  std::vector<uint64_t> words_;
+
+  static uint64_t bit(int index) {
+    return static_cast<uint64_t>(1) << (index & 63);
+  }
+
+  // bits of word w which fall into [begin, end)
+  static uint64_t rangeBits(int w, int begin, int end) {
+    uint64_t bits = ~static_cast<uint64_t>(0);
+    if (begin > (w << 6))
+      bits &= bits << (begin & 63);
+    if (end < ((w + 1) << 6))
+      bits &= ~(~static_cast<uint64_t>(0) << (end & 63));
+    return bits;
+  }
+
+  void clip(int &begin, int &end) const {
+    if (begin < 0)
+      begin = 0;
+    if (end > size())
+      end = size();
+  }
+
+  // n <= 64 bits starting at index, pixels outside the mask read as unset
+  uint64_t getBits(int index, int n) const {
+    uint64_t bits = 0;
+    int begin = index, end = index + n;
+    clip(begin, end);
+    if (begin >= end)
+      return 0;
+    int w = begin >> 6, offset = begin & 63;
+    bits = words_[w] >> offset;
+    if (offset && w + 1 < static_cast<int>(words_.size()))
+      bits |= words_[w + 1] << (64 - offset);
+    if (end - begin < 64)
+      bits &= ~(~static_cast<uint64_t>(0) << (end - begin));
+    return bits << (begin - index);
+  }
+
+  // writes the low n <= 64 bits of value starting at index
+  void setBits(int index, int n, uint64_t value) {
+    int w = index >> 6, offset = index & 63;
+    uint64_t keep = n < 64 ? ~static_cast<uint64_t>(0) << n : 0;
+    words_[w] = (words_[w] & ~(~keep << offset)) | (value << offset);
+    if (offset && offset + n > 64) {
+      words_[w + 1] = (words_[w + 1] & ~(~keep >> (64 - offset)))
+                      | (value >> (64 - offset));
+    }
+  }
+};
+
+#endif  // FEATURE_GENERATION_PCL_SRC_PIXEL_MASK_H_
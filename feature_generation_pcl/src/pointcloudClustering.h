@@ -6,6 +6,12 @@ Copyright (C) 2012 Hema Koppula
 #define FEATURE_GENERATION_PCL_SRC_POINTCLOUDCLUSTERING_H_
 
 #include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <utility>
 
 #include <pcl/ModelCoefficients.h>
 #include <pcl/kdtree/kdtree.h>
@@ -28,6 +34,7 @@ Copyright (C) 2012 Hema Koppula
 #include "includes/color.h"
 #include "includes/CombineUtils.h"
 #include "includes/CovarianceMatrix.h"
+#include "ransacPlane.h"
 
 typedef pcl::PointXYZRGB PointT;
 typedef pcl::PointXYZRGBCamSL PointOutT;
@@ -179,6 +186,178 @@ void extractEuclideanClusters(
   }
 }
 
+/*
+Return the root of the set containing a. Parents always point to a smaller
+index, so the root of a set is its smallest member.
+ */
+int findClusterRoot(const std::vector<int> &parent, int a) {
+  while (parent[a] != a)
+    a = parent[a];
+  return a;
+}
+
+/*
+Merge the sets containing a and b by linking the larger root below the
+smaller one. With atomic set, the link is a compare-and-swap that is retried
+if another thread re-rooted either set in the meantime, so the resulting
+forest does not depend on the order in which threads perform their unions.
+ */
+void linkClusterRoots(std::vector<int> &parent, int a, int b, bool atomic) {
+  while (true) {
+    a = findClusterRoot(parent, a);
+    b = findClusterRoot(parent, b);
+    if (a == b)
+      return;
+    if (a < b)
+      std::swap(a, b);
+    if (!atomic) {
+      parent[a] = b;
+      return;
+    }
+    if (__sync_bool_compare_and_swap(&parent[a], a, b))
+      return;
+  }
+}
+
+/*
+Multi-threaded version of the location based extractEuclideanClusters above.
+It returns exactly the same clusters in the same order.
+
+The search radius depends on the distance of the query point, so a neighbour
+relation can be one sided. Points which lie within each other's radius always
+end up in the same cluster; these are merged with a union-find where every
+thread owns a contiguous block of the cloud, unions its block locally and the
+links crossing block borders are merged atomically afterwards. The one sided
+links are then followed over the resulting components in index order, which
+is what the sequential region growing does.
+ */
+void extractEuclideanClustersParallel(
+  const pcl::PointCloud<PointOutT> &cloud,
+  const boost::shared_ptr<KdTree > &tree,
+  float tolerance, std::vector<pcl::PointIndices> &clusters,
+  unsigned int min_pts_per_cluster = 1,
+  unsigned int max_pts_per_cluster = (std::numeric_limits<int>::max) ()) {
+  if (tree->getInputCloud()->points.size() != cloud.points.size()) {
+    return;
+  }
+  int numPoints = cloud.points.size();
+  int numBlocks = 1;
+#ifdef _OPENMP
+  numBlocks = omp_get_max_threads();
+#endif
+  std::vector<int> parent(numPoints);
+  for (int i = 0; i < numPoints; i++)
+    parent[i] = i;
+
+  // links between blocks and one sided links found by each block
+  std::vector<std::vector<std::pair<int, int> > > borderLinks(numBlocks);
+  std::vector<std::vector<std::pair<int, int> > > directedLinks(numBlocks);
+
+#pragma omp parallel for schedule(static, 1)
+  for (int b = 0; b < numBlocks; b++) {
+    int first = static_cast<int64_t>(numPoints) * b / numBlocks;
+    int last = static_cast<int64_t>(numPoints) * (b + 1) / numBlocks;
+    std::vector<int> nn_indices;
+    std::vector<float> nn_distances;
+    for (int i = first; i < last; i++) {
+      float adjTolerance = cloud.points[i].distance * tolerance;
+      if (!tree->radiusSearch(i, adjTolerance, nn_indices, nn_distances))
+        continue;
+      for (size_t j = 0; j < nn_indices.size(); j++) {
+        int k = nn_indices[j];
+        if (k == i)
+          continue;
+        float kTolerance = cloud.points[k].distance * tolerance;
+        if (!(nn_distances[j] <= kTolerance * kTolerance)) {
+          directedLinks[b].push_back(std::make_pair(i, k));
+        } else if (k >= first && k < last) {
+          linkClusterRoots(parent, i, k, false);
+        } else {
+          borderLinks[b].push_back(std::make_pair(i, k));
+        }
+      }
+    }
+  }
+
+#pragma omp parallel for schedule(static, 1)
+  for (int b = 0; b < numBlocks; b++) {
+    for (size_t e = 0; e < borderLinks[b].size(); e++) {
+      linkClusterRoots(parent, borderLinks[b][e].first,
+                       borderLinks[b][e].second, true);
+    }
+  }
+
+  // parent[i] <= i, so a single pass in index order flattens the forest
+  for (int i = 0; i < numPoints; i++)
+    parent[i] = parent[parent[i]];
+
+  // members of each component, grouped by root and sorted by index
+  std::vector<int> memberStart(numPoints + 1, 0);
+  for (int i = 0; i < numPoints; i++)
+    memberStart[parent[i] + 1]++;
+  for (int i = 0; i < numPoints; i++)
+    memberStart[i + 1] += memberStart[i];
+  std::vector<int> members(numPoints);
+  std::vector<int> fill(memberStart.begin(), memberStart.end() - 1);
+  for (int i = 0; i < numPoints; i++)
+    members[fill[parent[i]]++] = i;
+
+  // one sided links between components
+  std::vector<std::pair<int, int> > componentLinks;
+  for (int b = 0; b < numBlocks; b++) {
+    for (size_t e = 0; e < directedLinks[b].size(); e++) {
+      int from = parent[directedLinks[b][e].first];
+      int to = parent[directedLinks[b][e].second];
+      if (from != to)
+        componentLinks.push_back(std::make_pair(from, to));
+    }
+  }
+  sort(componentLinks.begin(), componentLinks.end());
+  componentLinks.erase(unique(componentLinks.begin(), componentLinks.end()),
+                       componentLinks.end());
+  std::vector<int> linkStart(numPoints + 1, 0);
+  for (size_t e = 0; e < componentLinks.size(); e++)
+    linkStart[componentLinks[e].first + 1]++;
+  for (int i = 0; i < numPoints; i++)
+    linkStart[i + 1] += linkStart[i];
+
+  // grow the clusters over components, seeded in index order
+  std::vector<bool> processed(numPoints, false);
+  for (int i = 0; i < numPoints; i++) {
+    if (parent[i] != i || processed[i])
+      continue;
+    std::vector<int> seed_queue;
+    seed_queue.push_back(i);
+    processed[i] = true;
+    size_t clusterSize = 0;
+    for (size_t sq_idx = 0; sq_idx < seed_queue.size(); sq_idx++) {
+      int c = seed_queue[sq_idx];
+      clusterSize += memberStart[c + 1] - memberStart[c];
+      for (int e = linkStart[c]; e < linkStart[c + 1]; e++) {
+        int to = componentLinks[e].second;
+        if (processed[to])
+          continue;
+        processed[to] = true;
+        seed_queue.push_back(to);
+      }
+    }
+    // If this cluster is satisfactory, add to the clusters
+    if (clusterSize >= min_pts_per_cluster
+        && clusterSize <= max_pts_per_cluster) {
+      pcl::PointIndices r;
+      r.indices.reserve(clusterSize);
+      for (size_t j = 0; j < seed_queue.size(); j++) {
+        int c = seed_queue[j];
+        r.indices.insert(r.indices.end(), members.begin() + memberStart[c],
+                         members.begin() + memberStart[c + 1]);
+      }
+      sort(r.indices.begin(), r.indices.end());
+      r.header = cloud.header;
+      clusters.push_back(r);
+    }
+  }
+}
+
 void convert(const pcl::PointCloud<PointT> &cloud_in,
              pcl::PointCloud<PointOutT> &cloud_out) {
   cloud_out.points.resize(cloud_in.points.size());
@@ -250,9 +429,9 @@ int getClusters(pcl::PointCloud<PointOutT> &cloud,
                              clusterInds, angle, min_pts_per_cluster,
                              max_pts_per_cluster);
   } else {
-    extractEuclideanClusters(*cloud_ptr, clusters_tree_, radius,
-                             clusterInds, min_pts_per_cluster,
-                             max_pts_per_cluster);
+    extractEuclideanClustersParallel(*cloud_ptr, clusters_tree_, radius,
+                                     clusterInds, min_pts_per_cluster,
+                                     max_pts_per_cluster);
   }
   int max_cluster_index = getClustersFromPointCloud2(*cloud_ptr, clusterInds,
                                                       clustersOut);
@@ -346,7 +525,7 @@ void getNormal(pcl::PointCloud<PointT> &cloud, Eigen::Vector3d &normal) {
   Eigen::Matrix3d eigen_vectors;
   Eigen::Vector3d eigen_values;
   pcl::PointXYZ centroid;
-  computeCentroid(centroid, cloud);
+  // computes the centroid as well
   Eigen::Matrix3d covariance_matrix;
   computeCovarianceMatrix(cloud, covariance_matrix, centroid);
   for (unsigned int i = 0; i < 3; i++) {
@@ -354,9 +533,7 @@ void getNormal(pcl::PointCloud<PointT> &cloud, Eigen::Vector3d &normal) {
       covariance_matrix(i, j) /= static_cast<double> (cloud.points.size());
     }
   }
-  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> ei_symm(covariance_matrix);
-  eigen_values = ei_symm.eigenvalues();
-  eigen_vectors = ei_symm.eigenvectors();
+  computeEigen3x3(covariance_matrix, eigen_values, eigen_vectors);
   float minEigV = FLT_MAX;
   for (int i = 0; i < 3; i++) {
     if (minEigV > eigen_values(i)) {
@@ -400,8 +577,51 @@ void filterForTable(pcl::PointCloud<PointOutT> &cloud,
   cout << "num points in filtered cloud : " << cloud.points.size() << endl;
 }
 
+/*
+Table detection by fitting the dominant horizontal plane with RANSAC instead
+of clustering the whole filtered cloud. The table is the biggest cluster of
+the plane inliers, so that other surfaces at the same height are dropped.
+ */
+void getTableIndsRansac(pcl::PointCloud<PointOutT> &cloud,
+                        pcl::PointIndices &tablePoints,
+                        pcl::PointIndices &cloudInds) {
+  const float inlierThreshold = 20;  // mm
+  std::vector<float> x(cloud.points.size());
+  std::vector<float> y(cloud.points.size());
+  std::vector<float> z(cloud.points.size());
+  for (size_t i = 0; i < cloud.points.size(); i++) {
+    x[i] = cloud.points[i].x;
+    y[i] = cloud.points[i].y;
+    z[i] = cloud.points[i].z;
+  }
+  PlaneModel plane;
+  std::vector<int> inliers;
+  if (!fitPlaneRansac(x, y, z, inlierThreshold, 0.9, plane, inliers) ||
+      inliers.size() <= 1000) {
+    return;
+  }
+  pcl::PointCloud<PointOutT> planeCloud;
+  planeCloud.height = 1;
+  planeCloud.width = inliers.size();
+  planeCloud.points.resize(inliers.size());
+  for (size_t i = 0; i < inliers.size(); i++)
+    planeCloud.points[i] = cloud.points[inliers[i]];
+  std::vector<pcl::PointCloud<PointT> > clustersOut;
+  std::vector<pcl::PointIndices> clusterInds;
+  int max_cluster_index = getClusters(planeCloud, clustersOut, clusterInds,
+                                      false);
+  if (clusterInds.at(max_cluster_index).indices.size() <= 1000)
+    return;
+  // get the original indicies
+  const std::vector<int> &tableInds = clusterInds.at(max_cluster_index).indices;
+  for (size_t i = 0; i < tableInds.size(); i++) {
+    cloudInds.indices.push_back(
+        tablePoints.indices.at(inliers.at(tableInds.at(i))));
+  }
+}
+
 void getTableInds(pcl::PointCloud<PointT> &cloud_in,
-                  pcl::PointIndices &cloudInds) {
+                  pcl::PointIndices &cloudInds, bool useRansac = false) {
     // convert to PointXYZRGBCamSL format
   pcl::PointCloud<PointOutT> cloud;
   convert(cloud_in, cloud);
@@ -409,6 +629,10 @@ void getTableInds(pcl::PointCloud<PointT> &cloud_in,
   // filter out points too far and not near table
   pcl::PointIndices tablePoints;
   filterForTable(cloud, tablePoints);
+  if (useRansac) {
+    getTableIndsRansac(cloud, tablePoints, cloudInds);
+    return;
+  }
   std::vector<pcl::PointCloud<PointT> > clustersOut;
   std::vector<pcl::PointIndices> clusterInds;
   int maxSize = 0;
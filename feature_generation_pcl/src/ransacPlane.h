@@ -0,0 +1,208 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_RANSACPLANE_H_
+#define FEATURE_GENERATION_PCL_SRC_RANSACPLANE_H_
+
+#include <stdint.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <Eigen/Dense>
+
+#include "includes/CovarianceMatrix.h"
+
+// plane a*x + b*y + c*z + d = 0 with unit normal (a, b, c)
+struct PlaneModel {
+  float a, b, c, d;
+};
+
+/*
+Count the points within threshold of the plane. The points are passed as
+separate x, y and z arrays so that four of them are tested per instruction.
+ */
+int countPlaneInliers(const float *x, const float *y, const float *z, int n,
+                      const PlaneModel &plane, float threshold) {
+  int count = 0;
+  int i = 0;
+#ifdef __SSE2__
+  __m128 a = _mm_set1_ps(plane.a);
+  __m128 b = _mm_set1_ps(plane.b);
+  __m128 c = _mm_set1_ps(plane.c);
+  __m128 d = _mm_set1_ps(plane.d);
+  __m128 t = _mm_set1_ps(threshold);
+  __m128 sign = _mm_set1_ps(-0.0f);
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 4 <= n; i += 4) {
+    __m128 dist = _mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(x + i)),
+                             _mm_mul_ps(b, _mm_loadu_ps(y + i)));
+    dist = _mm_add_ps(dist, _mm_mul_ps(c, _mm_loadu_ps(z + i)));
+    dist = _mm_andnot_ps(sign, _mm_add_ps(dist, d));
+    // each inlier lane is all ones, i.e. -1
+    acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmplt_ps(dist, t)));
+  }
+  int lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+  count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+  for (; i < n; i++) {
+    if (fabsf(plane.a * x[i] + plane.b * y[i] + plane.c * z[i] + plane.d)
+        < threshold)
+      count++;
+  }
+  return count;
+}
+
+void getPlaneInliers(const float *x, const float *y, const float *z, int n,
+                     const PlaneModel &plane, float threshold,
+                     std::vector<int> &inliers) {
+  inliers.clear();
+  for (int i = 0; i < n; i++) {
+    if (fabsf(plane.a * x[i] + plane.b * y[i] + plane.c * z[i] + plane.d)
+        < threshold)
+      inliers.push_back(i);
+  }
+}
+
+/*
+Plane through three points, false if they are (nearly) collinear.
+ */
+bool planeFromPoints(const float *x, const float *y, const float *z,
+                     int p0, int p1, int p2, PlaneModel &plane) {
+  double u[3] = {x[p1] - x[p0], y[p1] - y[p0], z[p1] - z[p0]};
+  double v[3] = {x[p2] - x[p0], y[p2] - y[p0], z[p2] - z[p0]};
+  double n[3] = {u[1] * v[2] - u[2] * v[1],
+                 u[2] * v[0] - u[0] * v[2],
+                 u[0] * v[1] - u[1] * v[0]};
+  double norm = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  if (norm < 1e-6)
+    return false;
+  plane.a = n[0] / norm;
+  plane.b = n[1] / norm;
+  plane.c = n[2] / norm;
+  plane.d = -(plane.a * x[p0] + plane.b * y[p0] + plane.c * z[p0]);
+  return true;
+}
+
+/*
+Least squares plane through the inliers: the normal is the eigenvector of
+the smallest eigenvalue of their covariance.
+ */
+void refinePlane(const float *x, const float *y, const float *z,
+                 const std::vector<int> &inliers, PlaneModel &plane) {
+  if (inliers.size() < 3)
+    return;
+  MomentAccumulator moments;
+  for (size_t i = 0; i < inliers.size(); i++)
+    moments.add(x[inliers[i]], y[inliers[i]], z[inliers[i]]);
+  pcl::PointXYZ mean;
+  Eigen::Matrix3d covariance;
+  moments.getCentroid(mean);
+  moments.getScatter(covariance);
+  Eigen::Vector3d eigen_values;
+  Eigen::Matrix3d eigen_vectors;
+  computeEigen3x3(covariance, eigen_values, eigen_vectors);
+  Eigen::Vector3d normal = eigen_vectors.col(0);
+  // keep the orientation of the hypothesis
+  if (normal[0] * plane.a + normal[1] * plane.b + normal[2] * plane.c < 0)
+    normal = -normal;
+  plane.a = normal[0];
+  plane.b = normal[1];
+  plane.c = normal[2];
+  plane.d = -(normal[0] * mean.x + normal[1] * mean.y + normal[2] * mean.z);
+}
+
+// xorshift, so that the samples only depend on the hypothesis number
+uint32_t ransacRandom(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+/*
+Find the plane with the most points within threshold among the planes whose
+normal has |z component| >= minNormalZ. Hypotheses are generated and scored
+in parallel batches. Each hypothesis draws its sample from its own seed and
+ties go to the earlier hypothesis, so the result does not depend on the
+number of threads. Sampling stops once a plane with the current best inlier
+ratio would have been drawn with the given confidence, and the winner is
+refined by least squares on its inliers.
+Returns false if no plane was found.
+ */
+bool fitPlaneRansac(const std::vector<float> &x, const std::vector<float> &y,
+                    const std::vector<float> &z, float threshold,
+                    float minNormalZ, PlaneModel &plane,
+                    std::vector<int> &inliers, double confidence = 0.99,
+                    int maxIterations = 1000) {
+  const int batchSize = 64;
+  int n = x.size();
+  inliers.clear();
+  if (n < 3)
+    return false;
+
+  int bestCount = 0;
+  int required = maxIterations;
+  std::vector<PlaneModel> hypotheses(batchSize);
+  std::vector<int> counts(batchSize);
+  for (int first = 0; first < required; first += batchSize) {
+#pragma omp parallel for schedule(dynamic, 4)
+    for (int h = 0; h < batchSize; h++) {
+      uint32_t state = 2654435761u * (first + h + 1);
+      int p[3];
+      for (int k = 0; k < 3; k++)
+        p[k] = ransacRandom(state) % n;
+      counts[h] = -1;
+      if (p[0] == p[1] || p[0] == p[2] || p[1] == p[2])
+        continue;
+      if (!planeFromPoints(&x[0], &y[0], &z[0], p[0], p[1], p[2],
+                           hypotheses[h]))
+        continue;
+      if (fabsf(hypotheses[h].c) < minNormalZ)
+        continue;
+      counts[h] = countPlaneInliers(&x[0], &y[0], &z[0], n, hypotheses[h],
+                                    threshold);
+    }
+    for (int h = 0; h < batchSize; h++) {
+      if (counts[h] > bestCount) {
+        bestCount = counts[h];
+        plane = hypotheses[h];
+      }
+    }
+    if (bestCount > 0) {
+      double w = static_cast<double>(bestCount) / n;
+      double noSample = 1 - w * w * w;
+      if (noSample <= 0) {
+        required = 0;
+      } else if (noSample < 1) {
+        required = std::min(maxIterations, static_cast<int>(
+            ceil(log(1 - confidence) / log(noSample))));
+      }
+    }
+  }
+  if (bestCount == 0)
+    return false;
+
+  getPlaneInliers(&x[0], &y[0], &z[0], n, plane, threshold, inliers);
+  for (int iter = 0; iter < 2; iter++) {
+    PlaneModel refined = plane;
+    refinePlane(&x[0], &y[0], &z[0], inliers, refined);
+    if (fabsf(refined.c) < minNormalZ)
+      break;
+    if (countPlaneInliers(&x[0], &y[0], &z[0], n, refined, threshold)
+        < static_cast<int>(inliers.size()))
+      break;
+    plane = refined;
+    getPlaneInliers(&x[0], &y[0], &z[0], n, plane, threshold, inliers);
+  }
+  return true;
+}
+
+#endif  // FEATURE_GENERATION_PCL_SRC_RANSACPLANE_H_
@@ -330,6 +330,9 @@ class readData {
   }
 
   void closeRGBDData() {
+      if (file_RGBD == NULL) {
+        return;
+      }
       file_RGBD->close();
       printf("\tRGBD file closed\n");
   }
@@ -525,6 +528,20 @@ class readData {
                     int *data_pos_CONF, int ***IMAGE,
                     vector<vector<double> > &objFeats,
                     vector<vector<int> > &objPCInds) {
+    return readNextFrame(data, pos_data, data_CONF, data_pos_CONF, IMAGE,
+                         objFeats, objPCInds, NULL);
+  }
+
+  /*
+  The same, but the image of a frame f is only read if imageFrames[f] is non
+  zero. The RGBD line of any other frame is skipped without being parsed and
+  IMAGE is left as it was. A NULL imageFrames reads every image.
+   */
+  int readNextFrame(double **data, double **pos_data, int **data_CONF,
+                    int *data_pos_CONF, int ***IMAGE,
+                    vector<vector<double> > &objFeats,
+                    vector<vector<int> > &objPCInds,
+                    const vector<int> *imageFrames) {
     if (currentFrameNum % 100 == 0) {
       printf("\t\t(progress..) frame num = %d\n", currentFrameNum);
     }
@@ -535,8 +552,13 @@ class readData {
     }
     bool status_obj = readNextLine_ObjectData(objFeats);
     bool status_objPC = readNextLine_ObjectPCData(objPCInds);
+    bool readImage = (imageFrames == NULL) ||
+        (currentFrameNum >= 0 && currentFrameNum < (int)imageFrames->size() &&
+         imageFrames->at(currentFrameNum) != 0);
     bool status_RGBD = false;
-    if(compressed){
+    if (!readImage) {
+      status_RGBD = compressed ? skipNextLine_RGBD_c() : skipNextLine_RGBD();
+    } else if(compressed){
     	status_RGBD = readNextLine_RGBD_c(IMAGE);
     }else{
     	status_RGBD = readNextLine_RGBD(IMAGE);
@@ -621,6 +643,21 @@ class readData {
     prepareRGBDData();
   }
 
+  /*
+  Opens only the skeleton file, for the readNextFrame without an image. The
+  RGBD file is never opened, so it need not exist.
+   */
+  readData(string dataLoc, string fileN, bool skip) {
+    dataLocation = dataLoc;
+    fileName = fileN;
+    skipOdd = skip;
+    this->mirrored = false;
+    this->compressed = false;
+    file_RGBD = NULL;
+    lastFrame = 0;
+    prepareSkeletonData();
+  }
+
   int readNextFrame(double **data, double **pos_data, int **data_CONF,
                     int *data_pos_CONF, int ***IMAGE) {
     if (currentFrameNum % 100 == 0) {
@@ -658,6 +695,7 @@ class readData {
       printf("\t\ttotal number of frames = %d\n", lastFrame);
       return false;
     }
+    lastFrame = currentFrameNum;
     if (status)
       return currentFrameNum;
     else
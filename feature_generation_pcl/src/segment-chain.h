@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_SEGMENT_CHAIN_H_
+#define FEATURE_GENERATION_PCL_SRC_SEGMENT_CHAIN_H_
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "./segment-graph.h"
+
+/*
+segment_graph on a chain whose vertices come one at a time, vertex i being
+joined to vertex i - 1 by edge i - 1. The segments are the same as those of
+segment_graph on the whole chain, but each is finished as soon as no later
+vertex can change it, and only the unfinished segments are kept.
+
+segment_graph takes the edges by increasing weight, equal weights in chain
+order. At the turn of an edge, the two components it may join are made of
+the lighter edges up to the nearest heavier edge on either side of it. So
+the edge is decided, the same as in segment_graph, once a heavier edge has
+come after it and the lighter edges in between are decided. The undecided
+edges are thus a run of decreasing weights, each of which is decided when a
+heavier edge comes. The segments before the first of them are finished.
+ */
+class ChainSegmenter {
+ public:
+  // c is the thresholding parameter of segment_graph
+  explicit ChainSegmenter(float c) : c_(c), numVertices_(0) {}
+
+  /*
+  Adds the next vertex, joined to the previous one by an edge of weight w.
+  w is not used for the first vertex.
+   */
+  void addVertex(float w) {
+    if (numVertices_ > 0) {
+      int top = pending_.size();
+      while (top > 0 && pending_[top - 1].w <= w) {
+        top--;
+      }
+      // lightest first
+      for (int i = pending_.size() - 1; i >= top; i--) {
+        decide(pending_[i]);
+      }
+      pending_.resize(top);
+      edge e;
+      e.w = w;
+      e.a = numVertices_ - 1;
+      e.b = numVertices_;
+      pending_.push_back(e);
+    }
+    Component component;
+    component.first = numVertices_;
+    component.threshold = THRESHOLD(1, c_);
+    components_[numVertices_] = component;
+    numVertices_++;
+
+    int end = pending_.empty() ? numVertices_ - 1 : pending_.front().a;
+    finishBefore(end);
+  }
+
+  // decides the remaining edges, after the last vertex
+  void finish() {
+    for (int i = pending_.size() - 1; i >= 0; i--) {
+      decide(pending_[i]);
+    }
+    pending_.clear();
+    finishBefore(numVertices_);
+  }
+
+  /*
+  The oldest finished segment not taken yet, as its first and last vertex.
+  Returns false if there is none.
+   */
+  bool nextSegment(int &first, int &last) {
+    if (finished_.empty()) {
+      return false;
+    }
+    first = finished_.front().first;
+    last = finished_.front().second;
+    finished_.pop_front();
+    return true;
+  }
+
+  int numVertices() const { return numVertices_; }
+
+ private:
+  struct Component {
+    int first;
+    float threshold;
+  };
+
+  void decide(const edge &e) {
+    // the components ending at e.a and starting at e.b
+    std::map<int, Component>::iterator a = components_.find(e.a);
+    std::map<int, Component>::iterator b = a;
+    ++b;
+    if ((e.w <= a->second.threshold) && (e.w <= b->second.threshold)) {
+      b->second.first = a->second.first;
+      int size = b->first - b->second.first + 1;
+      b->second.threshold = e.w + THRESHOLD(size, c_);
+      components_.erase(a);
+    }
+  }
+
+  // the components which end before vertex end are finished
+  void finishBefore(int end) {
+    while (!components_.empty() && components_.begin()->first < end) {
+      finished_.push_back(std::make_pair(components_.begin()->second.first,
+                                         components_.begin()->first));
+      components_.erase(components_.begin());
+    }
+  }
+
+  float c_;
+  int numVertices_;
+  // the undecided edges, by decreasing weight
+  std::vector<edge> pending_;
+  // the unfinished components, by their last vertex
+  std::map<int, Component> components_;
+  std::deque<std::pair<int, int> > finished_;
+};
+
+#endif  // FEATURE_GENERATION_PCL_SRC_SEGMENT_CHAIN_H_
@@ -36,19 +36,17 @@ bool operator<(const edge &a, const edge &b) {
 }
 
 /*
- * Segment a graph
+ * Segment a graph whose edges are sorted by weight
  *
  * Returns a disjoint-set forest representing the segmentation.
  *
  * num_vertices: number of vertices in graph.
  * num_edges: number of edges in graph
- * edges: array of edges.
+ * edges: array of edges, in non-decreasing weight order.
  * c: constant for treshold function.
  */
-universe *segment_graph(int num_vertices, int num_edges, edge *edges, float c) {
-  // sort edges by weight
-  std::sort(edges, edges + num_edges);
-
+universe *segment_sorted_graph(int num_vertices, int num_edges,
+                               const edge *edges, float c) {
   // make a disjoint-set forest
   universe *u = new universe(num_vertices);
 
@@ -59,7 +57,7 @@ universe *segment_graph(int num_vertices, int num_edges, edge *edges, float c) {
 
   // for each edge, in non-decreasing weight order...
   for (int i = 0; i < num_edges; i++) {
-    edge *pedge = &edges[i];
+    const edge *pedge = &edges[i];
 
     // components conected by this edge
     int a = u->find(pedge->a);
@@ -74,8 +72,25 @@ universe *segment_graph(int num_vertices, int num_edges, edge *edges, float c) {
   }
 
   // free up
-  delete threshold;
+  delete [] threshold;
   return u;
 }
 
+/*
+ * Segment a graph
+ *
+ * Returns a disjoint-set forest representing the segmentation.
+ *
+ * num_vertices: number of vertices in graph.
+ * num_edges: number of edges in graph
+ * edges: array of edges.
+ * c: constant for treshold function.
+ */
+universe *segment_graph(int num_vertices, int num_edges, edge *edges, float c) {
+  // sort edges by weight, equal weights in the order given (ChainSegmenter
+  // relies on it)
+  std::stable_sort(edges, edges + num_edges);
+  return segment_sorted_graph(num_vertices, num_edges, edges, c);
+}
+
 #endif  // FEATURE_GENERATION_PCL_SRC_SEGMENT_GRAPH_H_
@@ -8,19 +8,42 @@ Copyright (C) 2012 Hema Koppula
 #include <assert.h>
 
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
+#include <deque>
 #include <algorithm>
 
 #include "./frame_skel.cpp"
 #include "./segment-graph.h"
+#include "./segment-chain.h"
+#include "./slidingOrderStatistic.h"
 
 using namespace std;
 
 class Segmentation_skel {
  private:
+  // the window of the median filter applied before the segmentation
+  static const int MEDIAN_WINDOW = 3;
+
   vector<FrameSkel> skeletons;
   vector<vector<int> > segmentation;
+  // see computeSegmentsSweep
+  vector<vector<vector<int> > > sweepSegmentations;
+
+  // state of the online segmentation, see startStream
+  deque<FrameSkel> window;
+  // index of the first frame of window
+  int windowStart;
+  int numStreamFrames;
+  int streamMethod;
+  ChainSegmenter *chain;
+  std::ofstream *streamFile;
+  int streamSegCount;
+
+  // one per coordinate of every joint, see medianFilterFrame
+  vector<SlidingOrderStatistic> medianWindows;
+  bool medianFilterPrimed;
 
   vector<double> get_displacement(const FrameSkel & skel1,
                                   const FrameSkel & skel2) {
@@ -63,26 +86,152 @@ class Segmentation_skel {
     return to_ret;
   }
 
-  void applyMedianFilter(int windowSize) {
-    int numJoints = skeletons.at(0).num_local_joints;
-    for (size_t i = windowSize/2; i < skeletons.size()-windowSize/2; i++) {
+  /*
+  Filters frame i of frames with the frames around it, the ones before it
+  having been filtered already. Each joint coordinate is replaced by the
+  (windowSize/2 - 1)th smallest of its window, which the segmentations have
+  always been made with. The windows are carried from the previous frame
+  unless startMedianFilter was called since.
+   */
+  template <typename Frames>
+  void medianFilterFrame(Frames &frames, size_t i, int windowSize) {
+    int numJoints = frames.at(i).num_local_joints;
+    int half = windowSize/2;
+    int coords[3] = {pos_data_x, pos_data_y, pos_data_z};
+    if (!medianFilterPrimed) {
+      medianWindows.assign(numJoints*3, SlidingOrderStatistic(half - 1));
+      for (int w = -half; w <= half; w++) {
+        for (int j = 0; j < numJoints; j++) {
+          for (int k = 0; k < 3; k++) {
+            medianWindows[j*3 + k].insert(
+                frames.at(i+w).joints_local[j][coords[k]]);
+          }
+        }
+      }
+      medianFilterPrimed = true;
+    } else {
       for (int j = 0; j < numJoints; j++) {
-        cout << j <<":" << endl;
-        vector<double> x, y, z;
-        for (int w = -windowSize/2; w <= windowSize/2; w ++) {
-          cout << i+w << "," << endl;
-          x.push_back(skeletons.at(i+w).joints_local[j][pos_data_x]);
-          y.push_back(skeletons.at(i+w).joints_local[j][pos_data_y]);
-          z.push_back(skeletons.at(i+w).joints_local[j][pos_data_z]);
+        for (int k = 0; k < 3; k++) {
+          SlidingOrderStatistic &window = medianWindows[j*3 + k];
+          window.erase(frames.at(i-half-1).joints_local[j][coords[k]]);
+          window.insert(frames.at(i+half).joints_local[j][coords[k]]);
         }
-        std::sort(x.begin(), x.end());
-        std::sort(y.begin(), y.end());
-        std::sort(z.begin(), z.end());
-        skeletons.at(i).joints_local[j][pos_data_x] = x[windowSize/2-1];
-        skeletons.at(i).joints_local[j][pos_data_y] = y[windowSize/2-1];
-        skeletons.at(i).joints_local[j][pos_data_z] = z[windowSize/2-1];
       }
     }
+    for (int j = 0; j < numJoints; j++) {
+      for (int k = 0; k < 3; k++) {
+        SlidingOrderStatistic &window = medianWindows[j*3 + k];
+        double &value = frames.at(i).joints_local[j][coords[k]];
+        double filtered = window.value();
+        // the next frame sees this one filtered
+        window.replace(value, filtered);
+        value = filtered;
+      }
+    }
+  }
+
+  void startMedianFilter() {
+    medianFilterPrimed = false;
+  }
+
+  void applyMedianFilter(int windowSize) {
+    startMedianFilter();
+    for (size_t i = windowSize/2; i < skeletons.size()-windowSize/2; i++) {
+      medianFilterFrame(skeletons, i, windowSize);
+    }
+  }
+
+  // frame f of the stream has all the frames it is filtered with
+  void finishStreamFrame(int f, bool filter) {
+    if (filter) {
+      medianFilterFrame(window, f - windowStart, MEDIAN_WINDOW);
+    }
+    // vertex f - 1 of computeSegmentsDynamic, with the edge from f - 2
+    if (f >= 1) {
+      float w = 0;
+      if (f >= 2) {
+        w = getWeight(window.at(f - 2 - windowStart),
+                      window.at(f - 1 - windowStart),
+                      window.at(f - windowStart), streamMethod);
+      }
+      chain->addVertex(w);
+    }
+    // keep what the next frames are filtered and weighted with
+    int keep = std::max(MEDIAN_WINDOW/2, 2);
+    while (windowStart < f + 1 - keep) {
+      window.pop_front();
+      windowStart++;
+    }
+    printStreamSegments();
+  }
+
+  void printStreamSegments() {
+    int first, last;
+    while (chain->nextSegment(first, last)) {
+      vector<int> frames;
+      for (int i = first; i <= last; i++) {
+        frames.push_back(i);
+      }
+      printSegment(*streamFile, frames, streamSegCount);
+    }
+  }
+
+  // Create Graph, each frame maps to a node,
+  // and each edge maps to the vector<double> disp1
+  // distance between two skeletons
+  void getEdges(int method, vector<edge> &edges) {
+    edges.clear();
+    for (size_t i = 1; i + 1 < skeletons.size(); i++) {
+      edge e;
+      e.a = (i - 1);
+      e.b = i;
+      e.w = getWeight(i-1, i, i+1, method);
+      edges.push_back(e);
+    }
+  }
+
+  // find all the skeleton's segments and setup the correct output
+  void getSegments(universe &segmented_frames,
+                   vector<vector<int> > &segments) {
+    for (size_t i = 0; i + 1 < skeletons.size(); i++) {
+      // To what segment does vertex i belong?
+      size_t cur_segment = segmented_frames.find(i);
+      while (cur_segment >= segments.size()) {
+        segments.push_back(vector<int>());
+      }
+      segments.at(cur_segment).push_back(i);
+    }
+  }
+
+  void printSegmentation(std::ofstream &file,
+                         const vector<vector<int> > &segments) {
+    // print the segments
+    int segCount = 1;
+    for (size_t i = 0; i < segments.size(); i++) {
+      if (segments.at(i).size() > 0) {
+        printSegment(file, segments.at(i), segCount);
+      }
+    }
+    file << endl;
+  }
+
+  // writes the frames as segments of at most 50 frames
+  void printSegment(std::ofstream &file, const vector<int> &frames,
+                    int &segCount) {
+    file << segCount << ":";
+    file << frames.at(0)+1;
+    for (size_t j = 1; j < frames.size(); j++) {
+      if (j%50 == 0) {
+        file << ";";
+        segCount++;
+        file << segCount << ":";
+        file << frames.at(j)+1;
+      } else {
+        file << "," << frames.at(j)+1;
+      }
+    }
+    file << ";";
+    segCount++;
   }
 
  public:
@@ -126,13 +275,19 @@ class Segmentation_skel {
   }
 
   double getWeight(int A, int B, int C, int method) {
+    return getWeight(skeletons.at(A), skeletons.at(B), skeletons.at(C),
+                     method);
+  }
+
+  double getWeight(const FrameSkel &A, const FrameSkel &B,
+                   const FrameSkel &C, int method) {
     double weight = 0;
     if (method == 1) {
-      vector<double> distp = get_displacement(skeletons.at(A), skeletons.at(B));
+      vector<double> distp = get_displacement(A, B);
       weight = two_norm(distp);
     } else if (method == 2) {
-      vector<double> distp = get_displacement(skeletons.at(A), skeletons.at(B));
-      vector<double> dista = get_displacement(skeletons.at(B), skeletons.at(C));
+      vector<double> distp = get_displacement(A, B);
+      vector<double> dista = get_displacement(B, C);
       weight = two_norm_squared(distp, dista);
     }
 
@@ -143,65 +298,103 @@ class Segmentation_skel {
   // from http://www.cs.brown.edu/~pff/segment/
   // c is the thresholding parameter as described in the algorithm
   void computeSegmentsDynamic(float c, int method) {
-    applyMedianFilter(3);
+    applyMedianFilter(MEDIAN_WINDOW);
     cout << "number of frames so far: " << skeletons.size() << endl;
     universe * segmented_frames;
 
-    // Create Graph, each frame maps to a node,
-    // and each edge maps to the vector<double> disp1
-    // distance between two skeletons
-    edge * edges = new edge[skeletons.size() - 2];
-    for (size_t i = 1; i < skeletons.size() - 1; i++) {
-      cout << "skel " << i - 1 << " and " << i << endl;
-      edges[(i - 1)].a = (i - 1);
-      edges[(i - 1)].b = i;
-
-      edges[(i - 1)].w = getWeight(i-1, i, i+1, method);
-    }
+    vector<edge> edges;
+    getEdges(method, edges);
 
     // Do segmentation based on the algorithm
-    segmented_frames = segment_graph(skeletons.size() - 1,
-                                     skeletons.size() - 2, edges, c);
+    segmented_frames = segment_graph(skeletons.size() - 1, edges.size(),
+                                     edges.empty() ? NULL : &edges[0], c);
+    getSegments(*segmented_frames, segmentation);
+    delete segmented_frames;
+  }
 
-    size_t cur_segment;
-    // find all the skeleton's segments and setup the correct output
-    for (size_t i = 0; i < skeletons.size() - 1; i++) {
-      // To what segment does vertex i belong?
-      cur_segment = (*segmented_frames).find(i);
-      while (cur_segment >= segmentation.size()) {
-        segmentation.push_back(vector<int>());
+  /*
+  computeSegmentsDynamic for every method and threshold, the frames being
+  filtered once and the edges of each method sorted once. Segmentation
+  i * thresholds.size() + j is that of methods[i] and thresholds[j], and is
+  printed by printSweepSegments.
+   */
+  void computeSegmentsSweep(const vector<int> &methods,
+                            const vector<float> &thresholds) {
+    applyMedianFilter(MEDIAN_WINDOW);
+    cout << "number of frames so far: " << skeletons.size() << endl;
+    sweepSegmentations.assign(methods.size() * thresholds.size(),
+                              vector<vector<int> >());
+    vector<edge> edges;
+    for (size_t i = 0; i < methods.size(); i++) {
+      getEdges(methods[i], edges);
+      std::stable_sort(edges.begin(), edges.end());
+      for (size_t j = 0; j < thresholds.size(); j++) {
+        universe *segmented_frames = segment_sorted_graph(
+            skeletons.size() - 1, edges.size(),
+            edges.empty() ? NULL : &edges[0], thresholds[j]);
+        getSegments(*segmented_frames,
+                    sweepSegmentations[i * thresholds.size() + j]);
+        delete segmented_frames;
       }
-      segmentation.at(cur_segment).push_back(i);
     }
   }
+
   void printSegments(std::ofstream &file) {
-    // print the segments
-    int segCount = 1;
-    for (size_t i = 0; i < segmentation.size(); i++) {
-      if (segmentation.at(i).size() > 0) {
-        file << segCount << ":";
-        file << segmentation.at(i).at(0)+1;
-        for (size_t j = 1; j < segmentation.at(i).size(); j++) {
-          if (j%50 == 0) {
-            file << ";";
-            segCount++;
-            file << segCount << ":";
-            file << segmentation.at(i).at(j)+1;
-          } else {
-            file << "," << segmentation.at(i).at(j)+1;
-          }
-        }
-        file << ";";
-        segCount++;
-      }
+    printSegmentation(file, segmentation);
+  }
+
+  void printSweepSegments(std::ofstream &file, int i) {
+    printSegmentation(file, sweepSegmentations.at(i));
+  }
+
+  /*
+  The online computeSegmentsDynamic: the frames are given one at a time to
+  addStreamFrame, and every segment is written to file as soon as no later
+  frame can change it, in the format of printSegments. The segments are the
+  same, but only the frames of the median filter window and the unfinished
+  segments are kept, see ChainSegmenter.
+   */
+  void startStream(float c, int method, std::ofstream &file) {
+    delete chain;
+    chain = new ChainSegmenter(c);
+    window.clear();
+    startMedianFilter();
+    windowStart = 0;
+    numStreamFrames = 0;
+    streamMethod = method;
+    streamFile = &file;
+    streamSegCount = 1;
+  }
+
+  void addStreamFrame(double **data, double **pos_data,
+                      string transformFile) {
+    window.push_back(FrameSkel(data, pos_data, transformFile));
+    numStreamFrames++;
+    // the last frame of the filter window of f came
+    int f = numStreamFrames - 1 - MEDIAN_WINDOW/2;
+    if (f >= 0) {
+      finishStreamFrame(f, f >= MEDIAN_WINDOW/2);
     }
-    file << endl;
   }
 
-  Segmentation_skel() {}
+  // the frames at the end are left unfiltered, as by applyMedianFilter
+  void finishStream() {
+    int f = std::max(numStreamFrames - MEDIAN_WINDOW/2, 0);
+    for (; f < numStreamFrames; f++) {
+      finishStreamFrame(f, false);
+    }
+    chain->finish();
+    printStreamSegments();
+    *streamFile << endl;
+  }
+
+  Segmentation_skel() : windowStart(0), numStreamFrames(0), streamMethod(1),
+                        chain(NULL), streamFile(NULL), streamSegCount(1),
+                        medianFilterPrimed(false) {}
 
   ~Segmentation_skel() {
     skeletons.clear();
     segmentation.clear();
+    delete chain;
   }
 };
@@ -0,0 +1,132 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_SKELETONIMPUTER_H_
+#define FEATURE_GENERATION_PCL_SRC_SKELETONIMPUTER_H_
+
+#include <ostream>
+#include <string>
+
+#include "constants.h"
+
+/*
+Fills in the skeleton values the tracker lost, from the earlier frames of the
+sequence: an orientation keeps its last tracked value and a position goes on
+with the velocity between its last two tracked values. A value which has not
+been tracked for more than maxGap frames is not predicted any more. A frame
+whose head or torso can be neither read nor predicted has no valid skeleton,
+since all the skeleton features are taken relative to them.
+ */
+class SkeletonImputer {
+ public:
+  explicit SkeletonImputer(int maxGap = 10)
+      : maxGap_(maxGap),
+        numFrames_(0),
+        numUntracked_(0),
+        numImputed_(0) {
+    reset();
+  }
+
+  void reset() {
+    for (int j = 0; j < JOINT_NUM; j++) {
+      orientations_[j].seen = false;
+      orientations_[j].age = 0;
+      positions_[j].seen = false;
+      positions_[j].age = 0;
+    }
+    for (int j = 0; j < POS_JOINT_NUM; j++) {
+      points_[j].seen = false;
+      points_[j].age = 0;
+    }
+  }
+
+  // forgets the earlier frames when the sequence changes
+  void startFrame(const std::string &sequenceId) {
+    if (sequenceId.compare(sequenceId_) != 0) {
+      reset();
+      sequenceId_ = sequenceId;
+    }
+  }
+
+  /*
+  Replaces the untracked values of data and pos_data, as read by readData
+  with their confidences, by their predictions. Returns false if the frame
+  has no valid skeleton.
+   */
+  bool impute(double **data, double **pos_data, int **data_CONF,
+              int *pos_data_CONF) {
+    bool known[JOINT_NUM];
+    for (int j = 0; j < JOINT_NUM; j++) {
+      known[j] = update(orientations_[j], data[j], JOINT_DATA_ORI_NUM,
+                        data_CONF[j][0] > 0, false);
+      known[j] &= update(positions_[j], data[j] + JOINT_DATA_ORI_NUM,
+                         JOINT_DATA_POS_NUM, data_CONF[j][1] > 0, true);
+    }
+    for (int j = 0; j < POS_JOINT_NUM; j++) {
+      update(points_[j], pos_data[j], POS_JOINT_DATA_NUM,
+             pos_data_CONF[j] > 0, true);
+    }
+    numFrames_++;
+    if (!known[HEAD_JOINT_NUM] || !known[TORSO_JOINT_NUM]) {
+      numUntracked_++;
+      return false;
+    }
+    return true;
+  }
+
+  void print(std::ostream &out) const {
+    out << "skeleton: " << numFrames_ << " frames, " << numUntracked_
+        << " without a valid skeleton, " << numImputed_
+        << " joint values imputed" << std::endl;
+  }
+
+ private:
+  struct Track {
+    double value[JOINT_DATA_ORI_NUM];
+    double velocity[JOINT_DATA_POS_NUM];
+    // frames since value was tracked
+    int age;
+    bool seen;
+  };
+
+  // false if the n values are neither tracked nor predicted
+  bool update(Track &track, double *values, int n, bool isTracked,
+              bool moving) {
+    track.age++;
+    if (isTracked) {
+      for (int k = 0; moving && k < n; k++) {
+        track.velocity[k] = (track.seen && track.age <= maxGap_)
+            ? (values[k] - track.value[k]) / track.age : 0;
+      }
+      for (int k = 0; k < n; k++) {
+        track.value[k] = values[k];
+      }
+      track.age = 0;
+      track.seen = true;
+      return true;
+    }
+    if (!track.seen || track.age > maxGap_) {
+      return false;
+    }
+    for (int k = 0; k < n; k++) {
+      values[k] = track.value[k];
+      if (moving) {
+        values[k] += track.velocity[k] * track.age;
+      }
+    }
+    numImputed_++;
+    return true;
+  }
+
+  int maxGap_;
+  std::string sequenceId_;
+  Track orientations_[JOINT_NUM];
+  Track positions_[JOINT_NUM];
+  Track points_[POS_JOINT_NUM];
+  long numFrames_;
+  long numUntracked_;
+  long numImputed_;
+};
+
+#endif  // FEATURE_GENERATION_PCL_SRC_SKELETONIMPUTER_H_
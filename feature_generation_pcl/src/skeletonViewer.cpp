@@ -100,28 +100,28 @@ void drawUpperSkeleton(double **data, double **pos_data, string transformfile,
   globalTransform = readTranform(transformfile);
   FrameSkel sf(data, pos_data, transformfile);
   vector<PointT> points;
-  for (size_t i = 0; i < sf.transformed_joints.size(); i++) {
+  for (int i = 0; i < sf.num_transformed_joints; i++) {
     std::stringstream ss;
     ss << "j" << i;
     cout << "adding joint " << ss.str() << endl;
-    p->addSphere(sf.transformed_joints.at(i), 10, 1, 0, 0, ss.str(), 0);
+    p->addSphere(sf.transformed_joints[i], 10, 1, 0, 0, ss.str(), 0);
   }
 
-  p->addLine(sf.transformed_joints.at(0), sf.transformed_joints.at(1),
+  p->addLine(sf.transformed_joints[0], sf.transformed_joints[1],
              1, 0, 0, "e1", 0);
-  p->addLine(sf.transformed_joints.at(1), sf.transformed_joints.at(2),
+  p->addLine(sf.transformed_joints[1], sf.transformed_joints[2],
              1, 0, 0, "e2", 0);
-  p->addLine(sf.transformed_joints.at(1), sf.transformed_joints.at(5),
+  p->addLine(sf.transformed_joints[1], sf.transformed_joints[5],
              1, 0, 0, "e3", 0);
-  p->addLine(sf.transformed_joints.at(1), sf.transformed_joints.at(3),
+  p->addLine(sf.transformed_joints[1], sf.transformed_joints[3],
              1, 0, 0, "e4", 0);
-  p->addLine(sf.transformed_joints.at(3), sf.transformed_joints.at(4),
+  p->addLine(sf.transformed_joints[3], sf.transformed_joints[4],
              1, 0, 0, "e5", 0);
-  p->addLine(sf.transformed_joints.at(5), sf.transformed_joints.at(6),
+  p->addLine(sf.transformed_joints[5], sf.transformed_joints[6],
              1, 0, 0, "e6", 0);
-  p->addLine(sf.transformed_joints.at(6), sf.transformed_joints.at(8),
+  p->addLine(sf.transformed_joints[6], sf.transformed_joints[8],
              1, 0, 0, "e7", 0);
-  p->addLine(sf.transformed_joints.at(4), sf.transformed_joints.at(7),
+  p->addLine(sf.transformed_joints[4], sf.transformed_joints[7],
              1, 0, 0, "e8", 0);
 }
 
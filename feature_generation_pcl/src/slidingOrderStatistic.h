@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2012 Hema Koppula
+*/
+
+#ifndef FEATURE_GENERATION_PCL_SRC_SLIDINGORDERSTATISTIC_H_
+#define FEATURE_GENERATION_PCL_SRC_SLIDINGORDERSTATISTIC_H_
+
+#include <assert.h>
+
+#include <set>
+
+/*
+The value of a given rank among a window of values which changes one value
+at a time, e.g. a sliding median. The values up to the rank are kept apart
+from the ones after it, so inserting or erasing a value and reading the one
+of the rank take O(log w) for w values.
+ */
+class SlidingOrderStatistic {
+ public:
+  // rank 0 is the smallest value, the median of n values has rank n/2
+  explicit SlidingOrderStatistic(int rank = 0) : rank_(rank) {}
+
+  void clear() {
+    low_.clear();
+    high_.clear();
+  }
+
+  void insert(double value) {
+    if (!low_.empty() && value <= *low_.rbegin()) {
+      low_.insert(value);
+    } else {
+      high_.insert(value);
+    }
+    balance();
+  }
+
+  // erases one of the values equal to value, which must be in the window
+  void erase(double value) {
+    if (!low_.empty() && value <= *low_.rbegin()) {
+      low_.erase(low_.find(value));
+    } else {
+      high_.erase(high_.find(value));
+    }
+    balance();
+  }
+
+  void replace(double oldValue, double newValue) {
+    erase(oldValue);
+    insert(newValue);
+  }
+
+  int size() const { return low_.size() + high_.size(); }
+
+  // needs more than rank values
+  double value() const {
+    assert(static_cast<int>(low_.size()) == rank_ + 1);
+    return *low_.rbegin();
+  }
+
+ private:
+  // low_ holds the rank + 1 smallest values, or all of them
+  void balance() {
+    while (static_cast<int>(low_.size()) > rank_ + 1) {
+      std::multiset<double>::iterator last = --low_.end();
+      high_.insert(*last);
+      low_.erase(last);
+    }
+    while (static_cast<int>(low_.size()) < rank_ + 1 && !high_.empty()) {
+      low_.insert(*high_.begin());
+      high_.erase(high_.begin());
+    }
+  }
+
+  int rank_;
+  std::multiset<double> low_;
+  std::multiset<double> high_;
+};
+
+#endif  // FEATURE_GENERATION_PCL_SRC_SLIDINGORDERSTATISTIC_H_